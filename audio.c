@@ -34,6 +34,7 @@ static const char *a_files[A_NUMSOUNDS] = {
 };
 
 static bool			isaudio = true;	// Is audio available?
+static bool			ismuted = false;	// Are sounds being ignored?
 static a_sounds_t	a_sounds;
 
 // Function prototypes
@@ -71,13 +72,22 @@ a_callback(void *unused, Uint8 *stream, int len) {
  */
 void
 a_play(a_sound_t sound) {
-	if (isaudio) {
+	if (isaudio && !ismuted) {
 		SDL_PauseAudio(0);
 		a_sounds.current = sound;
 		a_sounds.datapos = 0;
 	}
 }
 
+/*
+ *	Ignore sounds played until unmuted, e.g. while a game that has already 
+ *	been heard is run again.
+ */
+void
+a_mute(bool mute) {
+	ismuted = mute;
+}
+
 /*
  *	Initialise the audio sub-system: load wavs and open audio device.
  */
@@ -1,5 +1,7 @@
 /*
  *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <stdbool.h>
  */
 
 #ifndef AUDIO_H
@@ -10,6 +12,7 @@ typedef enum { A_DROP = 0, A_LINE, A_GAMEOVER } a_sound_t;
 
 // Function prototypes
 extern void a_play(a_sound_t sound);
+extern void a_mute(bool mute);
 extern void a_init(void);
 extern void a_cleanup(void);
 
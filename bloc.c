@@ -6,6 +6,8 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,9 +19,18 @@
 #include "bloc.h"
 #include "bmpfont.h"
 #include "board.h"
+#include "clock.h"
 #include "menu.h"
+#include "perft.h"
 #include "piece.h"
+#include "rng.h"
 #include "score.h"
+#include "game.h"
+#include "bot.h"
+#include "replay.h"
+#include "net.h"
+#include "share.h"
+#include "xbot.h"
 
 #define B_WMTITLE		"bloc"			// Window's title
 #define B_SCRBPP		0				// 0: current display bits per pixel
@@ -30,33 +41,43 @@
 #define B_FONTFILE		"image/font.png"	// Bitmap font
 #define B_MENUFILE		"image/menu.png"	// Menu background
 #define B_MSGFILE		"image/msg.png"		// Message box background
-#define	B_TICKLEN		20				// Game tick length in milliseconds
-#define B_MOVETICKS		5				// Number of ticks between movements
-#define B_GRAVTICKS		30				// Number of ticks gravity starts at
-#define B_DIFFTICKS		3000			// How often difficulty increases
+#define B_RATE			50				// Default game ticks per second
+#define B_MINRATE		10
+#define B_MAXRATE		1000
+#define B_FPS			60				// Default most frames drawn per second
+#define B_MAXFPS		1000
+#define B_MAXCATCHUP	5				// Most ticks run to catch up at once
+#define B_POLLMS		4				// Time between reading keys, in ms
+#define B_SPINUS		1000			// Default time spun before waking, in us
+#define B_PIECES		10000			// Default most pieces in a headless game
+#define B_MAXEVENTS		64				// Keys that can be queued
+#define B_DROPMS		20				// Time per drop for each difficulty
+#define B_DIFFMS		60000			// How often difficulty increases
+#define B_CELL			0x10000			// One cell, in 16.16 fixed point
+#define B_MAXGRAV		20				// Fastest fixed gravity, in cells per 
+										// 1/60 s
 #define B_INFOX			294				// Information display position
 #define B_INFOY			534
 #define B_INFOW			11				// Information display width, in chars
-#define B_MAXNAME		24				// Player's name maximum length
+#define B_DEBUGX		294				// Debug counters display position
+#define B_DEBUGY		330
+#define B_DEBUGFILE		"timing.txt"	// Debug counters written on exit
+#define B_WRITEONLY		"w"				// Open file to write
 #define B_INTROX		24				// Intro text offset
 #define B_INTROY		24
-
-// Current level, based on current difficulty
-#define B_LEV(x)		(1 + B_GRAVTICKS - (x))
-
-// Game piece's movement
-typedef struct {
-	int			xvel;	// x velocity
-	unsigned	xticks;	// Number of ticks till next x movement
-	unsigned	yticks;	// Number of ticks till next y movement (soft drop)
-} b_move_t;
-
-// Game piece's gravity
-typedef struct {
-	unsigned	diff;		// Current difficulty
-	unsigned	dropticks;	// Number of game ticks till next drop
-	unsigned	diffticks;	// Number of game ticks till next difficulty
-} b_grav_t;
+#define B_FOEY			438				// Other player's display position
+#define B_ROLLBACK		256				// Most ticks a versus game can go back
+#define B_NOREDO		0xFFFFFFFFU		// No ticks to run again
+#define B_GARBCOL		BLUE			// Colour of garbage lines
+#define B_USAGE			"usage: %s [--width n] [--height n] [--shapes name] " \
+						"[--seed n] [--bag] [--perft depth]\n" \
+						"       [--rate hz] [--gravity g] [--fps n] [--spin us] " \
+						"[--debug]\n" \
+						"       [--headless games] [--pieces n] [--record file] " \
+						"[--replay file] [--watch]\n" \
+						"       [--host addr] [--join addr] [--lag ms] " \
+						"[--share file]\n" \
+						"       [--bot command]\n"
 
 static SDL_Surface	*b_screen	= NULL;	// Game area
 static SDL_Surface	*b_title	= NULL;	// Title bitmap
@@ -67,117 +88,1322 @@ static SDL_Surface	*b_font		= NULL;	// Bitmap font
 static SDL_Surface	*b_menu		= NULL;	// Menu background
 static SDL_Surface	*b_msg		= NULL;	// Message box background
 
+/*
+ *	Keys read but not yet applied to the game, oldest first.  The main 
+ *	thread adds keys and the logic thread takes them off, each only moves 
+ *	its own end so neither waits for the other.  Keys are stamped with the 
+ *	time they were read, in ns, until they are taken off.
+ */
+static struct {
+	g_event_t	events[B_MAXEVENTS];
+	unsigned	head;		// Next key to apply, atomic
+	unsigned	tail;		// Where the next key read goes, atomic
+} b_queue;
+
+// Options set on the command line
+static struct {
+	int			w;			// Board size, in blocks
+	int			h;
+	const char	*shapes;	// Shape set or shapes file, NULL for Tetriminos
+	Uint64		seed;		// Seed for the next game
+	bool		seeded;		// Whether the seed was given
+	bool		bag;		// Deal shapes from a bag
+	int			perft;		// Depth to count placements to, 0 to play
+	int			rate;		// Game ticks per second
+	double		gravity;	// Fixed gravity in cells per 1/60 s, 0 for levels
+	int			fps;		// Most frames drawn per second, 0 for no limit
+	int			spin;		// Time spun before each tick or frame, in us
+	bool		debug;		// Show and save the frame pacing counters
+	int			headless;	// Games for the bot to play headless, 0 to play
+	int			pieces;		// Most pieces in a headless game
+	const char	*record;	// File to record games to, NULL for none
+	const char	*replay;	// File to play games back from, NULL for none
+	bool		watch;		// Play games back in the window at normal speed
+	const char	*host;		// Address to host a versus game on, or NULL
+	const char	*join;		// Address to join a versus game at, or NULL
+	int			lag;		// Latency added to a versus game, in ms
+	const char	*share;		// File to share the game's state in, or NULL
+	const char	*bot;		// Command to run a bot to play with, or NULL
+} b_opts = {
+	BD_W,
+	BD_H,
+	NULL,
+	0,
+	false,
+	false,
+	0,
+	B_RATE,
+	0.0,
+	B_FPS,
+	B_SPINUS,
+	false,
+	0,
+	B_PIECES,
+	NULL,
+	NULL,
+	false,
+	NULL,
+	NULL,
+	0,
+	NULL,
+	NULL
+};
+
+// Logic pacing counters
+typedef struct {
+	unsigned	ticks;		// Game ticks run
+	unsigned	overruns;	// Times more than a tick was due at once
+	unsigned	capped;		// Times catching up was cut short
+	Uint32		drift;		// Time dropped by cutting catching up, in ms
+} b_stats_t;
+
+// Logic pacing counters for all games played, logic thread only
+static b_stats_t b_stats;
+
+// Frames drawn for all games played, main thread only
+static unsigned b_drawn;
+
+// The game being played, only the logic thread uses it while it is running
+static struct {
+	bloc_game_t	game;
+	SDL_Thread	*thread;	// Logic thread
+	bool		quit;		// Stop the logic thread, atomic
+	bool		over;		// Logic thread has stopped, atomic
+	bool		gameover;	// Game ended by game over, once stopped
+	bool		record;		// Record the game in b_rec
+	bool		watch;		// Apply the keys of b_rec instead of those read
+	unsigned	next;		// Next key of b_rec to apply
+	bool		bot;		// Apply the keys of the external bot instead
+} b_play;
+
+// External bot's keys for the current piece, logic thread only
+static struct {
+	g_event_t	evs[XB_MAXKEYS];
+	int			n;			// Number of keys
+	int			next;		// Next key to apply
+	unsigned	asked;		// Piece the bot was last asked about
+	bool		waiting;	// Waiting for the bot to answer
+	Uint64		from;		// Game time its next move can be applied from
+} b_bot;
+
+// Game being recorded or played back
+static rp_game_t b_rec;
+
+// Games being played back from b_opts.replay
+static struct {
+	FILE		*fp;					// Replay file
+	char		shapes[RP_MAXNAME];		// Shapes every game must use
+	unsigned	games;					// Games played back
+	unsigned	failed;					// Games that didn't end as recorded
+} b_replay;
+
+// Bits of a player's keys over one tick of a versus game, see b_vskeys
+#define B_HELD(k)		(1U << (k))					// Held at the end
+#define B_PRESSED(k)	(1U << ((k) + G_HARD + 1))	// Pressed during
+#define B_HELDKEYS		(B_HELD(G_HARD + 1) - 1)	// Every held bit
+#define B_KEYSLOT(t)	((t) % (2 * B_ROLLBACK))	// Where a tick's keys go
+
+// State of a versus game besides the two games, saved with them
+typedef struct {
+	Uint16		held[2];	// Keys each player held after the last tick
+	unsigned	owed[2];	// Garbage lines each player is still to get
+	rng_t		rng;		// Generator for the gaps in garbage lines
+	bool		over[2];	// Each player's game is over
+	Uint32		end;		// Tick the game ended on, once either is over
+} b_match_t;
+
+// State of a versus game before a tick, to go back to
+typedef struct {
+	g_snap_t	games[2];
+	b_match_t	match;
+} b_vssnap_t;
+
+/*
+ *	Versus game between two players, each running both players' games, 
+ *	player 0 hosts.  Each tick is run as soon as it is due, with the other 
+ *	player predicted to hold the keys they last held and press nothing, and 
+ *	the state before it is saved.  When the other player's keys for a tick 
+ *	arrive and aren't what was predicted, the game is put back to before 
+ *	that tick and every tick since is run again, within the one wake up.  A 
+ *	player stops to wait for the other rather than get more than 
+ *	B_ROLLBACK ticks ahead of them.  Logic thread only while it is running.
+ */
+static struct {
+	nt_link_t	link;						// Link to the other player
+	int			me;							// Local player
+	bloc_game_t	games[2];					// Each player's game
+	b_match_t	match;
+	b_vssnap_t	snaps[B_ROLLBACK];			// State before each tick
+	Uint16		keys[2][2 * B_ROLLBACK];	// Keys used for each tick
+	Uint32		tick;						// Next tick to run
+	Uint32		confirmed;					// Ticks the other's keys are in for
+	Uint32		redo;						// First tick to run again
+	Uint16		last;						// Other player's latest keys
+	Uint16		held;						// Local keys held
+	Uint16		pressed;					// Local keys pressed since a tick
+	const char	*result;					// How the game ended, once over
+	unsigned	rollbacks;					// Times the game was put back
+	unsigned	rerun;						// Ticks run again
+	unsigned	deepest;					// Most ticks run again at once
+	Uint64		rerunns;					// Time running ticks again, in ns
+} b_vs;
+
+// The other player of a versus game, for drawing
+typedef struct {
+	bool		on;			// A versus game is being played
+	score_t		score;		// Other player's score
+	unsigned	lines;		// Lines they have cleared
+	unsigned	owed;		// Garbage lines still to come to the local player
+} b_foe_t;
+
+// A copy of the game published by the logic thread for drawing
+typedef struct {
+	bloc_game_t	game;
+	Uint64		base;		// Time, in ns, of the game's last tick
+	b_stats_t	stats;		// Logic pacing counters at the time
+	b_foe_t		foe;		// Other player, if a versus game
+} b_frame_t;
+
+/*
+ *	Triple buffer of frames.  The logic thread writes a frame into back then 
+ *	swaps it with mid, marked fresh.  Drawing swaps front with mid if mid is 
+ *	fresh and draws front.  Neither thread waits for the other and a frame 
+ *	is never changed while it is drawn.
+ */
+#define B_FRESH		4U		// Mid has not been drawn yet
+static struct {
+	b_frame_t	frames[3];
+	unsigned	back;		// Frame being written, logic thread only
+	unsigned	mid;		// Latest frame written, atomic
+	unsigned	front;		// Frame being drawn, main thread only
+} b_frames = { .back = 0, .mid = 1, .front = 2 };
+
+// Player's name for a new high score
+static struct {
+	char		s[S_MAXNAME+1];
+	unsigned	len;
+} b_name;
+
+/*
+ *	A scene is one screen of the game, e.g. the menu or the game itself.  
+ *	The main loop reads the keys, runs the scene and draws it, so timing, 
+ *	input and drawing are only done in one place.  Each returns the scene to 
+ *	go to next, or B_STAY, and any hook may be NULL.
+ *	enter	- set up the scene, each time it is gone to
+ *	leave	- tidy up the scene, each time it is left
+ *	key		- handle a key or other event, read at time now, in ns
+ *	update	- run the scene up to time now, in ns, and bring wake forward if 
+ *			  it must be run again sooner
+ *	draw	- draw the scene
+ */
+typedef struct {
+	void		(*enter)(void);
+	void		(*leave)(void);
+	b_sceneid_t	(*key)(const SDL_Event *event, Uint64 now);
+	b_sceneid_t	(*update)(Uint64 now, Uint64 *wake);
+	void		(*draw)(void);
+} b_scene_t;
+
 // Function prototypes
+static void b_run(b_sceneid_t id);
+static void b_wait(Uint64 now, Uint64 until);
+static b_sceneid_t b_event(const b_scene_t *scene, const SDL_Event *event, 
+		Uint64 now, bool *dirty);
+static b_sceneid_t b_menukey(const SDL_Event *event, Uint64 now);
+static void b_menudraw(void);
+static void b_gameenter(void);
+static void b_gameleave(void);
+static void b_startlogic(int (*logic)(void *), const bloc_game_t *game, 
+		const b_foe_t *foe);
+static int b_logic(void *unused);
+static bool b_nextkey(const bloc_game_t *game, Uint64 now, Uint64 time, 
+		g_event_t *ev);
+static bool b_iswatched(const bloc_game_t *game);
+static bool b_askbot(const bloc_game_t *game, Uint64 due);
+static void b_publish(const bloc_game_t *game, const b_foe_t *foe, 
+		Uint64 base);
+static const b_frame_t *b_latest(void);
+static b_sceneid_t b_gamekey(const SDL_Event *event, Uint64 now);
+static b_sceneid_t b_gameupdate(Uint64 now, Uint64 *wake);
+static void b_gamedraw(void);
+static b_sceneid_t b_anykey(const SDL_Event *event, Uint64 now);
+static void b_introdraw(void);
+static void b_scoresdraw(void);
+static b_sceneid_t b_overkey(const SDL_Event *event, Uint64 now);
+static void b_overdraw(void);
+static void b_nameenter(void);
+static b_sceneid_t b_namekey(const SDL_Event *event, Uint64 now);
+static void b_namedraw(void);
+static void b_watchenter(void);
+static b_sceneid_t b_watchkey(const SDL_Event *event, Uint64 now);
+static b_sceneid_t b_watchupdate(Uint64 now, Uint64 *wake);
+static void b_versusenter(void);
+static int b_versus(void *unused);
+static void b_vsadvance(Uint64 now);
+static void b_vsrecv(void);
+static bool b_vsredo(void);
+static void b_vsrun(Uint32 tick, bool again);
+static void b_vskeys(bloc_game_t *game, Uint16 held, Uint16 keys, 
+		bool *gameover);
+static bool b_vsisdone(void);
+static void b_vsfoe(b_foe_t *foe);
+static b_sceneid_t b_versuskey(const SDL_Event *event, Uint64 now);
+static b_sceneid_t b_versusupdate(Uint64 now, Uint64 *wake);
+static b_sceneid_t b_resultkey(const SDL_Event *event, Uint64 now);
+static void b_resultdraw(void);
 static void b_setpal(SDL_Surface *screen, SDL_Surface *bmp);
 static void b_drawtitle(SDL_Surface *screen, SDL_Surface *title);
 static SDL_Surface *b_loadimage(const char *file);
 static void b_cleanup(void);
-static bool b_keys(b_move_t *move, b_grav_t *grav, bool *gameover,
-		bool *exit);
-static void b_move(b_move_t *move, b_grav_t *grav, bool *gameover);
-static void b_drawinfo(const b_grav_t *grav);
+static void b_pushkey(SDLKey sym, bool down, Uint64 time);
+static bool b_popkey(g_event_t *ev);
+static void b_headless(void);
+static bool b_replayall(void);
+static void b_checkreplay(const bloc_game_t *game, bool gameover);
+static void b_getsetup(rp_setup_t *setup);
+static void b_usesetup(const rp_setup_t *setup);
+static void b_connect(void);
+static void b_vsfits(void);
+static void b_vsreport(void);
+static void b_tick(bloc_game_t *game, bool *gameover);
+static void b_move(bloc_game_t *game, bool *gameover);
+static bool b_issoft(const bloc_game_t *game);
+static void b_draw(const b_frame_t *frame, Uint32 part);
+static Uint32 b_fall(const bloc_game_t *game, Uint32 part);
+static void b_drawstats(const b_stats_t *stats);
+static void b_drawfoe(const b_foe_t *foe);
+static void b_savestats(void);
+static void b_setspeed(bloc_game_t *game);
+static void b_drawinfo(const bloc_game_t *game);
 static void b_init(void);
+static void b_initgame(bloc_game_t *game);
 static void b_setseed(void);
+static void b_args(int argc, char *argv[]);
+static int b_argint(const char *prog, const char *arg, int min, int max);
+static Uint64 b_argseed(const char *prog, const char *arg);
+static double b_arggrav(const char *prog, const char *arg);
+static void b_usage(const char *prog);
+
+// Scenes, in the order of b_sceneid_t
+static const b_scene_t b_scenes[B_EXIT] = {
+	// B_STAY
+	{ NULL,			NULL,			NULL,		NULL,			NULL },
+	// B_MENU
+	{ NULL,			NULL,			b_menukey,	NULL,			b_menudraw },
+	// B_GAME
+	{ b_gameenter,	b_gameleave,	b_gamekey,	b_gameupdate,	b_gamedraw },
+	// B_INTRO
+	{ NULL,			NULL,			b_anykey,	NULL,			b_introdraw },
+	// B_SCORES
+	{ NULL,			NULL,			b_anykey,	NULL,			b_scoresdraw },
+	// B_OVER
+	{ NULL,			NULL,			b_overkey,	NULL,			b_overdraw },
+	// B_NAME
+	{ b_nameenter,	NULL,			b_namekey,	NULL,			b_namedraw },
+	// B_WATCH
+	{ b_watchenter,	b_gameleave,	b_watchkey,	b_watchupdate,	b_gamedraw },
+	// B_VERSUS
+	{ b_versusenter, b_gameleave,	b_versuskey, b_versusupdate, b_gamedraw },
+	// B_RESULT
+	{ NULL,			NULL,			b_resultkey, NULL,			b_resultdraw }
+};
+
+/*
+ *	Run the scenes until the player exits, starting with the given one.  Each 
+ *	time round, the keys read are handed to the scene, the scene is run up 
+ *	to now and, at most b_opts.fps times a second, drawn.  The loop then 
+ *	sleeps until the scene next needs running, the next frame is due or 
+ *	B_POLLMS has gone, whichever is first.  A scene is drawn as soon as it is 
+ *	gone to.
+ *
+ *	A scene with no update only changes when a key is pressed, so it is 
+ *	only drawn again then or when the window needs repainting, and in 
+ *	between the loop blocks waiting for an event rather than waking every 
+ *	B_POLLMS.
+ */
+void
+b_run(b_sceneid_t id) {
+	SDL_Event			event;
+	b_sceneid_t			next	= B_STAY;	// Scene to go to
+	const b_scene_t		*scene;
+	bool				dirty	= true;		// Scene needs drawing
+	Uint64				now;				// Times, in ns
+	Uint64				wake;				// Time, in ns, to run again by
+	Uint64				start;				// Time, in ns, frames started
+	Uint64				frames	= 0;		// Frames drawn since start
+	Uint64				nextframe;			// Time, in ns, of next frame
+
+	assert(id > B_STAY && id < B_EXIT);
+	scene = &b_scenes[id];
+	if (scene->enter != NULL) {
+		(*scene->enter)();
+	}
+	start = nextframe = ck_now();
+	while (id != B_EXIT) {
+		if (!dirty && scene->update == NULL) {
+			if (SDL_WaitEvent(&event) == 0) {
+				b_error("Error waiting for event: %s\n", SDL_GetError());
+			}
+			next = b_event(scene, &event, ck_now(), &dirty);
+		}
+		now = ck_now();
+		while (next == B_STAY && SDL_PollEvent(&event)) {
+			next = b_event(scene, &event, now, &dirty);
+		}
+		wake = now + B_POLLMS * CK_MS;
+		if (next == B_STAY && scene->update != NULL) {
+			next = (*scene->update)(now, &wake);
+			dirty = true;
+		}
+		if (next != B_STAY) {
+			if (scene->leave != NULL) {
+				(*scene->leave)();
+			}
+			id = next;
+			next = B_STAY;
+			if (id != B_EXIT) {
+				scene = &b_scenes[id];
+				if (scene->enter != NULL) {
+					(*scene->enter)();
+				}
+				dirty = true;
+				start = nextframe = ck_now();
+				frames = 0;
+			}
+			continue;
+		}
+		if (dirty && ck_now() >= nextframe) {
+			if (scene->draw != NULL) {
+				(*scene->draw)();
+			}
+			dirty = false;
+			if (b_opts.fps > 0) {
+				frames++;
+				nextframe = start + frames * CK_SEC / b_opts.fps;
+				if (ck_now() >= nextframe) {
+					// Drawing has fallen behind, start counting again
+					start = nextframe = ck_now();
+					frames = 0;
+				}
+			}
+		}
+		if (dirty || scene->update != NULL) {
+			b_wait(now, MIN(wake, MAX(nextframe, now)));
+		}
+	}
+}
+
+/*
+ *	Wait till the given time.  Only a time sooner than keys are next read, 
+ *	B_POLLMS after now, is a tick or frame that is due and spun for, 
+ *	waiting to read keys again only sleeps so the processor isn't kept busy.
+ *	now	- time, in ns, the wait was worked out from
+ */
+void
+b_wait(Uint64 now, Uint64 until) {
+	if (until < now + B_POLLMS * CK_MS) {
+		ck_wait(until);
+	} else {
+		ck_sleep(until);
+	}
+}
+
+/*
+ *	Hand an event to the scene.  Returns the scene to go to, closing the 
+ *	window exits.
+ *	now		- time, in ns, the event was read at
+ *	dirty	- set to true if the scene may need drawing again
+ */
+b_sceneid_t
+b_event(const b_scene_t *scene, const SDL_Event *event, Uint64 now, 
+		bool *dirty) {
+	assert(scene != NULL && event != NULL && dirty != NULL);
+	switch (event->type) {
+		case SDL_QUIT:
+			return B_EXIT;
+		case SDL_KEYDOWN:
+		case SDL_VIDEOEXPOSE:
+			*dirty = true;
+			break;
+		default:
+			// VOID
+			break;
+	}
+	return (scene->key != NULL) ? (*scene->key)(event, now) : B_STAY;
+}
+
+/*
+ *	Handle a key for the menu scene.
+ */
+b_sceneid_t
+b_menukey(const SDL_Event *event, Uint64 now) {
+	(void) now;
+	return m_key(event);
+}
+
+/*
+ *	Draw the menu scene.
+ */
+void
+b_menudraw(void) {
+	m_draw(b_screen, b_menu, b_font, b_blocks, B_GAMEX, B_GAMEY);
+}
+
+/*
+ *	Start a new game.  The game runs on its own thread so drawing, however 
+ *	slow, never holds up a tick.  The main thread reads the keys and passes 
+ *	them to the logic thread, and draws the latest copy of the game the 
+ *	logic thread has published.  With b_opts.bot the external bot plays.
+ */
+void
+b_gameenter(void) {
+	rp_setup_t setup;		// Settings the game starts with
+
+	b_play.watch = false;
+	b_play.record = (b_opts.record != NULL);
+	b_play.bot = (b_opts.bot != NULL);
+	if (b_play.record) {
+		b_getsetup(&setup);
+		rp_start(&b_rec, &setup);
+	}
+	b_initgame(&b_play.game);
+	if (b_play.bot) {
+		memset(&b_bot, 0, sizeof(b_bot));
+		xb_game(&b_play.game);
+	}
+	b_startlogic(b_logic, &b_play.game, NULL);
+}
+
+/*
+ *	Start a logic thread, with the game it starts from published for 
+ *	drawing.
+ *	foe	- other player of a versus game, NULL if not one
+ */
+void
+b_startlogic(int (*logic)(void *), const bloc_game_t *game, 
+		const b_foe_t *foe) {
+	assert(logic != NULL && game != NULL);
+	b_queue.head = b_queue.tail = 0;
+	b_play.quit = b_play.over = false;
+	b_publish(game, foe, ck_now());
+	sh_write(game, false);
+	b_play.thread = SDL_CreateThread(logic, NULL);
+	if (b_play.thread == NULL) {
+		b_error("Error starting game thread: %s\n", SDL_GetError());
+	}
+}
+
+/*
+ *	Stop the logic thread, if it hasn't stopped already, and wait for it.  
+ *	A game being recorded is added to the recording file.
+ */
+void
+b_gameleave(void) {
+	B_STORE(&b_play.quit, true);
+	SDL_WaitThread(b_play.thread, NULL);
+	b_play.thread = NULL;
+	if (b_play.record) {
+		rp_save(&b_rec, b_opts.record);
+	}
+}
+
+/*
+ *	Run the game on the logic thread until it is over or b_play.quit is set.  
+ *	The game's logic runs on a fixed step, the time gone is added up and a 
+ *	tick is run for each whole tick's worth.  Times are kept in parts of a 
+ *	tick so rates that don't divide a second exactly don't drift.  Keys are 
+ *	applied in the order they were read at the game time they were read at, 
+ *	between the ticks before and after them, rather than waiting for the 
+ *	next tick.  Once the game has run, a copy of it is published for drawing.  
+ *	Each key applied is recorded if the game is being recorded.
+ *
+ *	When the thread wakes a tick or more after it meant to, because the 
+ *	system was slow, it has overrun.  The late ticks are caught up straight 
+ *	away, but no more than B_MAXCATCHUP of them, the rest of the time is 
+ *	dropped and the game falls behind the clock rather than running flat out 
+ *	after a long stall.  Keys read in the dropped time are applied as soon as 
+ *	the game is run to.
+ *
+ *	While the external bot plays, it is asked about each piece before the 
+ *	thread goes to sleep and its keys are applied once it answers, see 
+ *	b_nextkey.
+ */
+int
+b_logic(void *unused) {
+	bloc_game_t	*game;
+	bool		gameover	= false;	// Game is over when set to true
+	bool		changed;				// Game has run since it was published
+	Uint64		now, last;				// Times, in ns
+	Uint64		acc			= 0;		// Time not yet run, in ns times the 
+										// rate, CK_SEC a tick
+	Uint64		due;					// Time, in ns, meant to wake at
+	Uint64		late;					// Time late, same units as acc
+	Uint64		drop;					// Time dropped, same units
+	Uint64		wait;					// Time, in ns, till next tick
+	Uint64		time;					// Game time now, in parts of a tick
+	g_event_t	ev;						// Key to apply
+
+	(void) unused;
+	game = &b_play.game;
+	last = due = ck_now();
+	while (!gameover && !B_LOAD(&b_play.quit) && !b_iswatched(game)) {
+		now = ck_now();
+		acc += (now - last) * game->rate;
+		last = now;
+		late = (now > due) ? (now - due) * game->rate : 0;
+		if (late >= CK_SEC) {
+			b_stats.overruns++;
+		}
+		if (late >= (B_MAXCATCHUP + 1) * CK_SEC) {
+			drop = (late / CK_SEC - B_MAXCATCHUP) * CK_SEC;
+			acc -= drop;
+			b_stats.capped++;
+			b_stats.drift += (Uint32) (drop / game->rate / CK_MS);
+		}
+		time = game->time + acc * G_TICKPART / CK_SEC;
+		changed = false;
+		while (!gameover && b_nextkey(game, now, time, &ev)) {
+			while (acc >= CK_SEC && ev.time >= game->time + G_TICKPART 
+			&&     !gameover) {
+				b_tick(game, &gameover);
+				acc -= CK_SEC;
+			}
+			if (!gameover) {
+				if (b_play.record) {
+					rp_add(&b_rec, &ev);
+				}
+				g_key(game, &ev, &gameover);
+			}
+			changed = true;
+		}
+		while (acc >= CK_SEC && !gameover && !b_iswatched(game)) {
+			b_tick(game, &gameover);
+			acc -= CK_SEC;
+			changed = true;
+		}
+		if (changed) {
+			b_publish(game, NULL, now - acc / game->rate);
+			sh_write(game, gameover);
+		}
+		wait = (CK_SEC - acc + game->rate - 1) / game->rate;
+		due = now + MIN(wait, B_POLLMS * CK_MS);
+		if (!b_play.bot || gameover || !b_askbot(game, due)) {
+			b_wait(now, due);
+		}
+	}
+	b_play.gameover = gameover;
+	if (b_play.record) {
+		rp_end(&b_rec, game, gameover);
+	}
+	if (b_play.bot) {
+		xb_end(game, gameover);
+	}
+	B_STORE(&b_play.over, true);
+	return 0;
+}
+
+/*
+ *	Get the next key to apply by game time now, logic thread only.  While a 
+ *	replay is watched the keys come from it, while the external bot plays 
+ *	they are its keys, otherwise they are the keys read, with the time they 
+ *	were read turned into game time.  The bot moves at most once a tick, its 
+ *	keys are held till the next tick is due then applied before it runs, so 
+ *	they come before that tick's gravity.  Returns false if there are no 
+ *	keys to apply yet.
+ *	now		- time, in ns
+ *	time	- game time now, in parts of a tick
+ */
+bool
+b_nextkey(const bloc_game_t *game, Uint64 now, Uint64 time, g_event_t *ev) {
+	Uint64 back;	// Parts of a tick since the key was read
+
+	assert(game != NULL && ev != NULL);
+	if (b_play.bot) {
+		while (b_popkey(ev)) {
+			// VOID, keys read are dropped while the bot plays
+		}
+		if (b_bot.next == b_bot.n || time < b_bot.from) {
+			return false;
+		}
+		*ev = b_bot.evs[b_bot.next++];
+		ev->time = game->time;
+		return true;
+	}
+	if (b_play.watch) {
+		if (b_play.next == b_rec.nkeys || b_rec.keys[b_play.next].time > time) {
+			return false;
+		}
+		*ev = b_rec.keys[b_play.next++];
+		return true;
+	}
+	if (!b_popkey(ev)) {
+		return false;
+	}
+	back = (now > ev->time) 
+		? (now - ev->time) * game->rate * G_TICKPART / CK_SEC : 0;
+	ev->time = (time > game->time + back) ? time - back : game->time;
+	return true;
+}
+
+/*
+ *	Returns true if a replay is being watched and the game has been run to 
+ *	where its recording ended.
+ */
+bool
+b_iswatched(const bloc_game_t *game) {
+	assert(game != NULL);
+	return b_play.watch && b_play.next == b_rec.nkeys 
+		&& game->time >= b_rec.ticks * G_TICKPART;
+}
+
+/*
+ *	Ask the external bot about the piece that has come on to the board, once 
+ *	any full lines have gone or sooner if the piece would fall on the next 
+ *	tick, and wait for it to answer, logic thread only.  It is only waited 
+ *	for until the thread is due to wake anyway, a bot that is slower than 
+ *	that answers on a later wake, so it never holds up a tick.  Its keys are 
+ *	held till the next tick is due, however soon it answers.  Returns true 
+ *	if it has answered with keys to apply.  If the bot goes wrong the player 
+ *	takes over.
+ *	due	- time, in ns, the thread is due to wake
+ */
+bool
+b_askbot(const bloc_game_t *game, Uint64 due) {
+	Uint64 now;
+	int n;			// Number of keys, or XB_WAIT or XB_GONE
+
+	assert(game != NULL);
+	if (!b_bot.waiting) {
+		if (game->pieces == b_bot.asked || (game->board.pending > 0 
+		&&  game->grav.fall + game->grav.speed < B_CELL)) {
+			return false;
+		}
+		xb_send(game);
+		b_bot.asked = game->pieces;
+		b_bot.waiting = true;
+	}
+	now = ck_now();
+	n = xb_reply(game, (due > now) ? (int) ((due - now) / CK_MS) : 0, 
+			b_bot.evs);
+	if (n == XB_WAIT) {
+		return false;
+	}
+	b_bot.waiting = false;
+	if (n == XB_GONE) {
+		b_play.bot = false;
+		return false;
+	}
+	b_bot.n = n;
+	b_bot.next = 0;
+	b_bot.from = (game->time / G_TICKPART + 1) * G_TICKPART;
+	return n > 0;
+}
+
+/*
+ *	Publish a copy of the game for drawing, logic thread only.
+ *	foe		- other player of a versus game, NULL if not one
+ *	base	- time, in ns, of the game's last tick
+ */
+void
+b_publish(const bloc_game_t *game, const b_foe_t *foe, Uint64 base) {
+	b_frame_t *frame;
+
+	assert(game != NULL);
+	frame = &b_frames.frames[b_frames.back];
+	frame->game = *game;
+	frame->base = base;
+	frame->stats = b_stats;
+	if (foe != NULL) {
+		frame->foe = *foe;
+	} else {
+		frame->foe.on = false;
+	}
+	b_frames.back = B_SWAP(&b_frames.mid, b_frames.back | B_FRESH) & ~B_FRESH;
+}
+
+/*
+ *	Returns the latest frame published, main thread only.  It stays the same 
+ *	until this is called again.
+ */
+const b_frame_t *
+b_latest(void) {
+	if (B_LOAD(&b_frames.mid) & B_FRESH) {
+		b_frames.front = B_SWAP(&b_frames.mid, b_frames.front) & ~B_FRESH;
+	}
+	return &b_frames.frames[b_frames.front];
+}
+
+/*
+ *	Handle a key for the game scene.  The game's keys are queued, stamped 
+ *	with the time they were read at.  SDL doesn't say when an event happened 
+ *	so it is stamped as soon as it is read, which is why the keys are read 
+ *	every B_POLLMS rather than once a tick.  Escape quits the game.
+ */
+b_sceneid_t
+b_gamekey(const SDL_Event *event, Uint64 now) {
+	assert(event != NULL);
+	switch (event->type) {
+		case SDL_KEYDOWN:
+			if (event->key.keysym.sym == SDLK_ESCAPE) {
+				return B_MENU;
+			}
+			b_pushkey(event->key.keysym.sym, true, now);
+			break;
+		case SDL_KEYUP:
+			b_pushkey(event->key.keysym.sym, false, now);
+			break;
+		default:
+			// VOID
+			break;
+	}
+	return B_STAY;
+}
+
+/*
+ *	Go to the game over scene once the logic thread has stopped.
+ */
+b_sceneid_t
+b_gameupdate(Uint64 now, Uint64 *wake) {
+	(void) now;
+	(void) wake;
+	return B_LOAD(&b_play.over) ? B_OVER : B_STAY;
+}
+
+/*
+ *	Draw the latest frame of the game, with the falling piece part of the 
+ *	way to where it will be after the next tick.
+ */
+void
+b_gamedraw(void) {
+	const b_frame_t *frame;
+	Uint64 part;	// Part of the next tick gone, in 16.16 fixed point
+
+	frame = b_latest();
+	part = (ck_now() - frame->base) * frame->game.rate * B_CELL / CK_SEC;
+	b_draw(frame, (Uint32) MIN(part, B_CELL - 1));
+	b_drawn++;
+}
+
+/*
+ *	Go back to the menu when any key is pressed.
+ */
+b_sceneid_t
+b_anykey(const SDL_Event *event, Uint64 now) {
+	assert(event != NULL);
+	(void) now;
+	return (event->type == SDL_KEYDOWN) ? B_MENU : B_STAY;
+}
+
+/*
+ *	Print introduction and keyboard controls.
+ */
+void
+b_introdraw(void) {
+	b_drawbg(b_screen, b_menu);
+	bf_printf(b_screen, b_font, B_GAMEX+B_INTROX, B_GAMEY+B_INTROY,
+		 // "1234567890123456789012345678901234"
+			"Fit the shapes together to make   \n"
+			"full lines. Full lines are cleared\n"
+			"and score points.                 \n"
+			"\n"
+			"Move the falling shape with the   \n"
+			"left and right arrow keys. Rotate \n"
+			"the shape with the up arrow key.  \n"
+			"\n"
+			"Use the space bar to \"hard drop\"\n"
+			"the shape into place for extra    \n"
+			"points! Use the down arrow key to \n"
+			"speed up the falling shape.       \n"
+			"\n"
+			"The falling shapes gradually speed\n"
+			"up but you get bigger scores too! \n"
+			"Press escape to quit the game     \n"
+			"early. The game ends when the next\n"
+			"piece will not fit onto the board.\n"
+			"\n"
+			"Summary:\n"
+			"\n"
+			"Up arrow    - rotate\n"
+			"Left arrow  - move left\n"
+			"Right arrow - move right\n"
+			"Down arrow  - soft drop\n"
+			"Space bar   - hard drop\n"
+			"Escape      - quit\n");
+	b_update(b_screen);
+}
+
+/*
+ *	Display high scores.
+ */
+void
+b_scoresdraw(void) {
+	s_display(b_screen, b_font, b_menu, B_GAMEX, B_GAMEY);
+}
+
+/*
+ *	Wait for return once the game is over, then enter the player's name if 
+ *	they have a high score.
+ */
+b_sceneid_t
+b_overkey(const SDL_Event *event, Uint64 now) {
+	assert(event != NULL);
+	(void) now;
+	if (event->type != SDL_KEYDOWN) {
+		return B_STAY;
+	}
+	switch (event->key.keysym.sym) {
+		case SDLK_RETURN:
+		case SDLK_KP_ENTER:
+			return s_ishigh(s_get(&b_play.game)) ? B_NAME : B_MENU;
+		default:
+			return B_STAY;
+	}
+}
+
+/*
+ *	Draw the game over message over the last frame of the game.
+ */
+void
+b_overdraw(void) {
+	bf_msgbox(b_screen, b_font, b_msg, BF_CENTRE, 
+			s_ishigh(s_get(&b_play.game)) ? "New high score! Press Return"
+			                              : "Game over! Press Return");
+	b_update(b_screen);
+}
+
+/*
+ *	Start entering the player's name.
+ */
+void
+b_nameenter(void) {
+	b_name.s[0] = '\0';
+	b_name.len = 0;
+	SDL_EnableUNICODE(1);
+}
+
+/*
+ *	Handle a key for the player's name, once it is finished the high score 
+ *	is entered.
+ */
+b_sceneid_t
+b_namekey(const SDL_Event *event, Uint64 now) {
+	(void) now;
+	if (!s_keyname(event, b_name.s, &b_name.len, S_MAXNAME)) {
+		return B_STAY;
+	}
+	SDL_EnableUNICODE(0);
+	s_newhigh(s_get(&b_play.game), b_name.s);
+	return B_MENU;
+}
+
+/*
+ *	Draw the player's name so far.
+ */
+void
+b_namedraw(void) {
+	s_drawname(b_screen, b_font, b_msg, b_name.s);
+}
+
+/*
+ *	Start watching the game in b_rec at normal speed.  Its keys are applied 
+ *	at the game times they were recorded at instead of the keys read.
+ */
+void
+b_watchenter(void) {
+	b_usesetup(&b_rec.setup);
+	b_play.watch = true;
+	b_play.record = false;
+	b_play.bot = false;
+	b_play.next = 0;
+	b_initgame(&b_play.game);
+	b_startlogic(b_logic, &b_play.game, NULL);
+}
+
+/*
+ *	Handle a key while watching a replay, escape stops watching.
+ */
+b_sceneid_t
+b_watchkey(const SDL_Event *event, Uint64 now) {
+	assert(event != NULL);
+	(void) now;
+	if (event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_ESCAPE) {
+		return B_EXIT;
+	}
+	return B_STAY;
+}
+
+/*
+ *	Once the game watched has stopped, check it ended as recorded and go on 
+ *	to the next game in the replay file, if there is one.
+ */
+b_sceneid_t
+b_watchupdate(Uint64 now, Uint64 *wake) {
+	(void) now;
+	(void) wake;
+	if (!B_LOAD(&b_play.over)) {
+		return B_STAY;
+	}
+	b_checkreplay(&b_play.game, b_play.gameover);
+	return rp_load(b_replay.fp, b_opts.replay, &b_rec) ? B_WATCH : B_EXIT;
+}
+
+/*
+ *	Start a versus game, once the link to the other player is made.  Both 
+ *	players' games start from the same seed, so they get the same pieces.  
+ *	The game runs on its own thread like any other, see b_versus.
+ */
+void
+b_versusenter(void) {
+	b_foe_t foe;		// Other player
+	Uint64 seed;		// Seed for both games
+
+	b_play.watch = false;
+	b_play.record = false;
+	b_play.bot = false;
+	seed = b_opts.seed;
+	for (int p = 0; p < 2; p++) {
+		b_opts.seed = seed;
+		b_initgame(&b_vs.games[p]);
+	}
+	memset(&b_vs.match, 0, sizeof(b_vs.match));
+	rng_seed(&b_vs.match.rng, seed);
+	b_vs.tick = b_vs.confirmed = 0;
+	b_vs.redo = B_NOREDO;
+	b_vs.last = b_vs.held = b_vs.pressed = 0;
+	b_vs.result = NULL;
+	b_vsfoe(&foe);
+	b_startlogic(b_versus, &b_vs.games[b_vs.me], &foe);
+}
+
+/*
+ *	Run a versus game on the logic thread until it is over, the other 
+ *	player has gone or b_play.quit is set.  Ticks are run on a fixed step, 
+ *	as in b_logic, but the keys read are applied at the start of the next 
+ *	tick, and sent to the other player stamped with it, so both players 
+ *	apply every key at the same tick.  The other player's keys are read as 
+ *	they arrive and the game is run again from the first tick they were 
+ *	predicted wrong for.  The game is only over once the tick it ended on 
+ *	has both players' keys in, so both players see the same ending.
+ */
+int
+b_versus(void *unused) {
+	b_foe_t		foe;					// Other player
+	b_match_t	*match;
+	bool		changed;				// Game has run since it was published
+	bool		flushed;				// Every frame sent has been written
+	Uint64		now, last;				// Times, in ns
+	Uint64		acc			= 0;		// Time not yet run, in ns times the 
+										// rate, CK_SEC a tick
+	Uint64		wait;					// Time, in ns, till next tick
+	unsigned	rate;					// Game ticks per second
+
+	(void) unused;
+	match = &b_vs.match;
+	rate = b_vs.games[0].rate;
+	last = ck_now();
+	while (!B_LOAD(&b_play.quit)) {
+		now = ck_now();
+		acc = MIN(acc + (now - last) * rate, (B_MAXCATCHUP + 1) * CK_SEC);
+		last = now;
+		b_vsrecv();
+		changed = b_vsredo();
+		while (acc >= CK_SEC && !match->over[0] && !match->over[1]
+		&&     b_vs.tick < b_vs.confirmed + B_ROLLBACK - 1) {
+			b_vsadvance(now);
+			acc -= CK_SEC;
+			changed = true;
+		}
+		flushed = nt_flush(&b_vs.link, now);
+		if (changed) {
+			b_vsfoe(&foe);
+			b_publish(&b_vs.games[b_vs.me], &foe,
+					now - MIN(acc, CK_SEC) / rate);
+			sh_write(&b_vs.games[b_vs.me], b_vs.match.over[b_vs.me]);
+		}
+		if (b_vsisdone()) {
+			if (flushed) {
+				break;
+			}
+		} else if (b_vs.link.closed) {
+			b_vs.result = "The other player has left!";
+			break;
+		}
+		wait = (acc < CK_SEC) ? (CK_SEC - acc + rate - 1) / rate : CK_SEC;
+		b_wait(now, now + MIN(wait, B_POLLMS * CK_MS));
+	}
+	if (b_vsisdone()) {
+		if (match->over[0] && match->over[1]) {
+			b_vs.result = "It's a draw!";
+		} else {
+			b_vs.result = match->over[b_vs.me] ? "You lose!" : "You win!";
+		}
+	}
+	a_mute(false);
+	B_STORE(&b_play.over, true);
+	return 0;
+}
+
+/*
+ *	Run the next tick with the keys read since the last one, sending them 
+ *	to the other player.
+ *	now	- time, in ns
+ */
+void
+b_vsadvance(Uint64 now) {
+	g_event_t ev;			// Key read
+	nt_frame_t frame;		// Keys sent
+
+	while (b_popkey(&ev)) {
+		if (ev.down) {
+			b_vs.held |= B_HELD(ev.key);
+			b_vs.pressed |= B_PRESSED(ev.key);
+		} else {
+			b_vs.held &= ~B_HELD(ev.key);
+		}
+	}
+	frame.tick = b_vs.tick;
+	frame.keys = b_vs.held | b_vs.pressed;
+	b_vs.pressed = 0;
+	b_vs.keys[b_vs.me][B_KEYSLOT(frame.tick)] = frame.keys;
+	nt_send(&b_vs.link, &frame, now);
+	b_vsrun(b_vs.tick++, false);
+}
+
+/*
+ *	Read the other player's keys that have arrived.  A tick already run 
+ *	with keys that turn out to be wrong is marked to be run again from.  
+ *	Keys must arrive for each tick in turn, and no further ahead than the 
+ *	other player can run, or the link is closed.
+ */
+void
+b_vsrecv(void) {
+	nt_frame_t frame;		// Keys read
+	Uint16 *keys;			// Where they go
+
+	while (nt_recv(&b_vs.link, &frame)) {
+		if (frame.tick != b_vs.confirmed 
+		||  frame.tick >= b_vs.tick + B_ROLLBACK) {
+			fprintf(stderr, "Error: keys for tick %lu out of turn\n", 
+					(unsigned long) frame.tick);
+			nt_close(&b_vs.link);
+			return;
+		}
+		keys = &b_vs.keys[1-b_vs.me][B_KEYSLOT(frame.tick)];
+		if (frame.tick < b_vs.tick && *keys != frame.keys) {
+			b_vs.redo = MIN(b_vs.redo, frame.tick);
+		}
+		*keys = frame.keys;
+		b_vs.last = frame.keys;
+		b_vs.confirmed++;
+	}
+}
+
+/*
+ *	Put the game back to before the first tick the other player's keys 
+ *	were predicted wrong for and run every tick since again.  Returns false 
+ *	if there was nothing to run again.
+ */
+bool
+b_vsredo(void) {
+	const b_vssnap_t *snap;		// State to go back to
+	Uint64 start;				// Time, in ns, run again from
+	Uint32 redo;				// First tick to run again
+
+	if (b_vs.redo >= b_vs.tick) {
+		b_vs.redo = B_NOREDO;
+		return false;
+	}
+	start = ck_now();
+	redo = b_vs.redo;
+	snap = &b_vs.snaps[redo % B_ROLLBACK];
+	for (int p = 0; p < 2; p++) {
+		g_restore(&b_vs.games[p], &snap->games[p]);
+	}
+	b_vs.match = snap->match;
+	for (Uint32 t = redo; t < b_vs.tick; t++) {
+		b_vsrun(t, true);
+	}
+	b_vs.rollbacks++;
+	b_vs.rerun += b_vs.tick - redo;
+	b_vs.deepest = MAX(b_vs.deepest, b_vs.tick - redo);
+	b_vs.rerunns += ck_now() - start;
+	b_vs.redo = B_NOREDO;
+	return true;
+}
+
+/*
+ *	Run one tick of both games, saving the state before it.  Each player's 
+ *	keys are applied at the start of the tick, then any garbage lines owed 
+ *	are pushed up under them, then the tick is run.  Clearing two or more 
+ *	lines at once sends one less than that as garbage to the other player, 
+ *	less any garbage still owed to the player who cleared them.  Once 
+ *	either game is over, neither is run any further.
+ *	again	- the tick is being run again, so it has already been heard
+ */
+void
+b_vsrun(Uint32 tick, bool again) {
+	b_vssnap_t *snap;		// State before the tick
+	b_match_t *match;
+	bloc_game_t *game;
+	unsigned lines[2];		// Lines cleared before the tick
+	unsigned sent;			// Garbage lines sent
+	unsigned cancel;		// Garbage lines owed that are cancelled
+
+	match = &b_vs.match;
+	snap = &b_vs.snaps[tick % B_ROLLBACK];
+	for (int p = 0; p < 2; p++) {
+		g_snapshot(&b_vs.games[p], &snap->games[p]);
+	}
+	snap->match = *match;
+	if (tick >= b_vs.confirmed) {
+		b_vs.keys[1-b_vs.me][B_KEYSLOT(tick)] = b_vs.last & B_HELDKEYS;
+	}
+	if (match->over[0] || match->over[1]) {
+		return;
+	}
+	for (int p = 0; p < 2; p++) {
+		a_mute(again || p != b_vs.me);
+		game = &b_vs.games[p];
+		lines[p] = game->lines;
+		b_vskeys(game, match->held[p], b_vs.keys[p][B_KEYSLOT(tick)], 
+				&match->over[p]);
+		match->held[p] = b_vs.keys[p][B_KEYSLOT(tick)] & B_HELDKEYS;
+		if (match->owed[p] > 0 && !match->over[p]) {
+			if (!bd_garbage(game, MIN(match->owed[p], 
+					(unsigned) game->board.h - 1), 
+					(int) rng_below(&match->rng, game->board.w), B_GARBCOL)) {
+				match->over[p] = true;
+			}
+			match->owed[p] = 0;
+			p_lift(game, &match->over[p]);
+		}
+		if (!match->over[p]) {
+			b_tick(game, &match->over[p]);
+		}
+	}
+	for (int p = 0; p < 2; p++) {
+		sent = b_vs.games[p].lines - lines[p];
+		if (sent > 1) {
+			sent--;
+			cancel = MIN(sent, match->owed[p]);
+			match->owed[p] -= cancel;
+			match->owed[1-p] += sent - cancel;
+		}
+	}
+	if (match->over[0] || match->over[1]) {
+		match->end = tick;
+	}
+	a_mute(false);
+}
+
+/*
+ *	Apply a player's keys for a tick to their game, at the time of its last 
+ *	tick.  Each key has a bit for whether it is held at the end of the tick 
+ *	and one for whether it was pressed during it, so a key tapped within a 
+ *	tick is pressed and released, and one released and pressed again is 
+ *	released and pressed.
+ *	held		- keys held at the end of the last tick
+ *	gameover	- set to true if a key ends the game
+ */
+void
+b_vskeys(bloc_game_t *game, Uint16 held, Uint16 keys, bool *gameover) {
+	g_event_t ev;		// Key to apply
+
+	assert(game != NULL && gameover != NULL);
+	ev.time = game->time;
+	for (int k = G_LEFT; k <= G_HARD && !*gameover; k++) {
+		ev.key = (g_key_t) k;
+		if ((held & B_HELD(k)) 
+		&&  (!(keys & B_HELD(k)) || (keys & B_PRESSED(k)))) {
+			ev.down = false;
+			g_key(game, &ev, gameover);
+		}
+		if ((keys & B_PRESSED(k)) && !*gameover) {
+			ev.down = true;
+			g_key(game, &ev, gameover);
+			if (!(keys & B_HELD(k)) && !*gameover) {
+				ev.down = false;
+				g_key(game, &ev, gameover);
+			}
+		}
+	}
+}
+
+/*
+ *	Returns true once either game is over and the tick it ended on has both 
+ *	players' keys in, so it can't be run again.
+ */
+bool
+b_vsisdone(void) {
+	return (b_vs.match.over[0] || b_vs.match.over[1]) 
+		&& b_vs.confirmed > b_vs.match.end;
+}
+
+/*
+ *	Get the other player's game, as far as it has been run, for drawing.
+ */
+void
+b_vsfoe(b_foe_t *foe) {
+	const bloc_game_t *game;	// Other player's game
+
+	assert(foe != NULL);
+	game = &b_vs.games[1-b_vs.me];
+	foe->on = true;
+	foe->score = s_get(game);
+	foe->lines = game->lines;
+	foe->owed = b_vs.match.owed[b_vs.me];
+}
 
 /*
- *	Start a new game.  Returns true if we are exiting the game, i.e. the user
- *	has closed the window.
+ *	Handle a key for a versus game, the game's keys are queued as in 
+ *	b_gamekey.  Escape leaves the game, and the other player wins.
  */
-bool
-b_newgame(void) {
-	bool		quit		= false;		// Quit once set to true
-	bool		exit		= false;		// Exit game when set to true
-	bool		gameover	= false;		// Game is over when set to true
-	Uint32		nexttick;					// Time, in ms, of next game tick
-	b_move_t	move		= { 0, 0, 0 };	// Game piece's movement
-	b_grav_t	grav		= {				// Game piece's gravity
-		B_GRAVTICKS,
-		B_GRAVTICKS,
-		B_DIFFTICKS
-	};
-	char 		name[S_MAXNAME+1];			// Player's name for high score
-
-	s_init();
-	p_init();
-	bd_init();
-	nexttick = SDL_GetTicks() + B_TICKLEN;
-	do {
-		b_drawbg(b_screen, b_game);
-		bd_draw(b_screen, b_blocks);
-		p_draw(b_screen, b_blocks);
-		b_drawinfo(&grav);
-		b_update(b_screen);
-		quit = b_keys(&move, &grav, &gameover, &exit);
-		b_move(&move, &grav, &gameover);
-		bd_chkrm();
-		SDL_Delay(b_delaylen(nexttick));
-		nexttick += B_TICKLEN;
-	} while (!quit && !gameover);
-	if (gameover) {
-		if (s_ishigh(s_get())) {
-			bf_msgbox(b_screen, b_font, b_msg, BF_CENTRE,
-					"New high score! Press Return");
-			b_update(b_screen);
-			exit = b_waitkey(B_RETURNONLY);
-			if (!exit) {
-				exit = s_entername(b_screen, b_font, b_msg, name, S_MAXNAME);
-				s_newhigh(s_get(), name);
-			}
-		} else {
-			bf_msgbox(b_screen, b_font, b_msg, BF_CENTRE,
-					"Game over! Press Return");
-			b_update(b_screen);
-			exit = b_waitkey(B_RETURNONLY);
-		}
+b_sceneid_t
+b_versuskey(const SDL_Event *event, Uint64 now) {
+	assert(event != NULL);
+	if (event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_ESCAPE) {
+		return B_EXIT;
 	}
-	return exit;
+	return b_gamekey(event, now);
 }
 
 /*
- *	Print introduction and keyboard controls.
+ *	Show how the versus game ended once the logic thread has stopped.
  */
-bool
-b_intro(void) {
-	b_drawbg(b_screen, b_menu);
-	bf_printf(b_screen, b_font, B_GAMEX+B_INTROX, B_GAMEY+B_INTROY,
-		 // "1234567890123456789012345678901234"
-			"Fit the shapes together to make   \n"
-			"full lines. Full lines are cleared\n"
-			"and score points.                 \n"
-			"\n"
-			"Move the falling shape with the   \n"
-			"left and right arrow keys. Rotate \n"
-			"the shape with the up arrow key.  \n"
-			"\n"
-			"Use the space bar to \"hard drop\"\n"
-			"the shape into place for extra    \n"
-			"points! Use the down arrow key to \n"
-			"speed up the falling shape.       \n"
-			"\n"
-			"The falling shapes gradually speed\n"
-			"up but you get bigger scores too! \n"
-			"Press escape to quit the game     \n"
-			"early. The game ends when the next\n"
-			"piece will not fit onto the board.\n"
-			"\n"
-			"Summary:\n"
-			"\n"
-			"Up arrow    - rotate\n"
-			"Left arrow  - move left\n"
-			"Right arrow - move right\n"
-			"Down arrow  - soft drop\n"
-			"Space bar   - hard drop\n"
-			"Escape      - quit\n");
-	b_update(b_screen);
-	return b_waitkey(B_ANYKEY);
+b_sceneid_t
+b_versusupdate(Uint64 now, Uint64 *wake) {
+	(void) now;
+	(void) wake;
+	return B_LOAD(&b_play.over) ? B_RESULT : B_STAY;
 }
 
 /*
- *	Display high scores.
+ *	Exit once return is pressed after a versus game.
  */
-bool
-b_scores(void) {
-	return s_display(b_screen, b_font, b_menu, B_GAMEX, B_GAMEY);
+b_sceneid_t
+b_resultkey(const SDL_Event *event, Uint64 now) {
+	assert(event != NULL);
+	(void) now;
+	if (event->type != SDL_KEYDOWN) {
+		return B_STAY;
+	}
+	switch (event->key.keysym.sym) {
+		case SDLK_RETURN:
+		case SDLK_KP_ENTER:
+			return B_EXIT;
+		default:
+			return B_STAY;
+	}
+}
+
+/*
+ *	Draw how the versus game ended over its last frame.
+ */
+void
+b_resultdraw(void) {
+	bf_msgbox(b_screen, b_font, b_msg, BF_CENTRE, "%s Press Return", 
+			b_vs.result);
+	b_update(b_screen);
 }
 
 /*
@@ -269,21 +1495,6 @@ b_strdup(const char *s) {
 	return p;
 }
 
-/*
- *	Return the time, in milliseconds, till next.
- */
-Uint32
-b_delaylen(Uint32 next) {
-	Uint32 now;
-
-	now = SDL_GetTicks();
-	if (next <= now) {
-		return 0;
-	} else {
-		return next - now;
-	}
-}
-
 /*
  *	Prints the formatted error message and exits with status EXIT_FAILURE.
  */
@@ -305,6 +1516,15 @@ b_error(const char *msg, ...) {
  */
 void
 b_cleanup(void) {
+	if (b_replay.fp != NULL) {
+		fclose(b_replay.fp);
+	}
+	rp_free(&b_rec);
+	if (b_opts.host != NULL || b_opts.join != NULL) {
+		nt_close(&b_vs.link);
+	}
+	sh_close();
+	xb_stop();
 	s_cleanup();
 	a_cleanup();
 	if (b_msg != NULL) {
@@ -333,187 +1553,541 @@ b_cleanup(void) {
 }
 
 /*
- *	Wait for a key press.  If keys equals B_RETURNONLY then only wait for
- *	enter.
+ *	Add a key to the end of the queue, if it is one the game uses, main 
+ *	thread only.  Up rotates, left and right move, down is soft drop and 
+ *	space bar is hard drop.  Keys are dropped if the queue is full.
+ *	time	- time, in ns, the key was read
+ */
+void
+b_pushkey(SDLKey sym, bool down, Uint64 time) {
+	g_event_t *ev;
+	unsigned tail;		// Where the key goes
+
+	tail = b_queue.tail;
+	if (tail - B_LOAD(&b_queue.head) == B_MAXEVENTS) {
+		return;
+	}
+	ev = &b_queue.events[tail % B_MAXEVENTS];
+	switch (sym) {
+		case SDLK_LEFT:
+			ev->key = G_LEFT;
+			break;
+		case SDLK_RIGHT:
+			ev->key = G_RIGHT;
+			break;
+		case SDLK_UP:
+			ev->key = G_ROT;
+			break;
+		case SDLK_DOWN:
+			ev->key = G_SOFT;
+			break;
+		case SDLK_SPACE:
+			ev->key = G_HARD;
+			break;
+		default:
+			return;
+	}
+	ev->down = down;
+	ev->time = time;
+	B_STORE(&b_queue.tail, tail + 1);
+}
+
+/*
+ *	Take the oldest key off the queue, logic thread only.  Returns false if 
+ *	the queue is empty.
  */
 bool
-b_waitkey(b_waitkey_t keys) {
-	SDL_Event	event;
-	bool 		quit		= false;		// Quit waiting
-	bool 		exit		= false;		// Exit game, i.e. window closed
-	Uint32		nexttick;					// Time, in ms, of next game tick
+b_popkey(g_event_t *ev) {
+	unsigned head;		// Where the key is
 
-	nexttick = SDL_GetTicks() + B_TICKLEN;
-	do {
-		while (SDL_PollEvent(&event)) {
-			switch (event.type) {
-				case SDL_KEYDOWN:
-					if (keys == B_RETURNONLY) {
-						switch (event.key.keysym.sym) {
-							case SDLK_RETURN:
-							case SDLK_KP_ENTER:
-								quit = true;
-								break;
-							default:
-								// VOID
-								break;
-						}
-					} else {
-						quit = true;
-					}
-					break;
-				case SDL_QUIT:
-					quit = exit = true;
-					break;
-				default:
-					// VOID
-					break;
+	assert(ev != NULL);
+	head = b_queue.head;
+	if (head == B_LOAD(&b_queue.tail)) {
+		return false;
+	}
+	*ev = b_queue.events[head % B_MAXEVENTS];
+	B_STORE(&b_queue.head, head + 1);
+	return true;
+}
+
+/*
+ *	Have the bot play b_opts.headless games, with no window or sound and as 
+ *	fast as possible, then print how fast they ran and the seed they started 
+ *	from.  The bot moves as soon as each piece comes on to the board and any 
+ *	full lines have gone, its keys are applied as if they were read then, 
+ *	and the game runs a tick.  A game stops once b_opts.pieces pieces have 
+ *	been placed, if it hasn't ended before.  A shared state is written as 
+ *	each piece comes on.  With b_opts.bot the external bot is asked for each 
+ *	move instead, and waited for.
+ */
+void
+b_headless(void) {
+	static bloc_game_t game;
+	g_event_t evs[XB_MAXKEYS];		// Keys for the bot's move
+	bt_move_t move;					// Bot's move
+	rp_setup_t setup;				// Settings each game starts with
+	bool gameover;
+	unsigned long pieces = 0;		// Pieces placed in all games
+	unsigned long total = 0;		// Scores added together
+	score_t best = 0;				// Best score
+	unsigned ticks;					// Ticks run before the games
+	Uint64 start;					// Time, in ns, the games started
+	Uint64 seed;					// First game's seed
+	double secs;
+	int n;
+
+	seed = b_opts.seed;
+	ticks = b_stats.ticks;
+	start = ck_now();
+	for (int i = 0; i < b_opts.headless; i++) {
+		if (b_opts.record != NULL) {
+			b_getsetup(&setup);
+			rp_start(&b_rec, &setup);
+		}
+		b_initgame(&game);
+		xb_game(&game);
+		gameover = false;
+		for (int j = 0; j < b_opts.pieces && !gameover; j++) {
+			while (game.board.pending > 0 && !gameover) {
+				b_tick(&game, &gameover);
 			}
+			sh_write(&game, gameover);
+			if (gameover) {
+				break;
+			}
+			if (b_opts.bot != NULL) {
+				xb_send(&game);
+				do {
+					n = xb_reply(&game, XB_FOREVER, evs);
+				} while (n == XB_WAIT);
+				if (n == XB_GONE) {
+					b_error("Error: no move from the bot\n");
+				}
+			} else {
+				bt_plan(&game, &move);
+				n = bt_keys(&move, game.time, evs);
+			}
+			for (int k = 0; k < n && !gameover; k++) {
+				if (b_opts.record != NULL) {
+					rp_add(&b_rec, &evs[k]);
+				}
+				g_key(&game, &evs[k], &gameover);
+			}
+			pieces++;
+			if (!gameover) {
+				b_tick(&game, &gameover);
+			}
+		}
+		xb_end(&game, gameover);
+		if (b_opts.record != NULL) {
+			rp_end(&b_rec, &game, gameover);
+			rp_save(&b_rec, b_opts.record);
 		}
-		SDL_Delay(b_delaylen(nexttick));
-		nexttick += B_TICKLEN;
-	} while (!quit);
-	return exit;
+		total += s_get(&game);
+		best = MAX(best, s_get(&game));
+	}
+	ticks = b_stats.ticks - ticks;
+	secs = (double) (ck_now() - start) / CK_SEC;
+	if (secs <= 0) {
+		secs = 1.0 / CK_SEC;
+	}
+	printf("%d games, %u ticks, %lu pieces, %.3f s, %.0f ticks/s, "
+			"%.0f pieces/s, %.0fx real time\n", b_opts.headless, ticks, 
+			pieces, secs, ticks / secs, pieces / secs, 
+			ticks / secs / b_opts.rate);
+	printf("mean score %lu, best score %lu, first seed %llu\n", 
+			total / b_opts.headless, best, (unsigned long long) seed);
 }
 
 /*
- *	Handle key presses and user quit request.  User requests quit by closing
- *	the window or pressing escape.  Piece is rotated if user presses up.
- *	Piece is moved left or right if left or right key is pressed.  Piece
- *	should be moved again when the number of ticks has passed, unless the user
- *	releases the key.  Up key is soft drop, space bar is hard drop.
- *	move->xvel		- set to 1 if user is moving piece right, -1 if moving left
- *	move->xticks	- set to number of ticks till next piece movement
- *	move->yticks	- set to number of ticks till next soft drop movement
- *	grav			- required to get current difficulty
- *	gameover		- set to true if the game is over after a hard drop
- *	exit 			- set to true if exiting the game, i.e. window closed
+ *	Play back every game in the replay file as fast as possible, with no 
+ *	window or sound, checking each ends as it was recorded, then print how 
+ *	fast they ran.  The keys are applied between the same ticks they were 
+ *	recorded between.  Returns false if any game didn't end as recorded.
  */
 bool
-b_keys(b_move_t *move, b_grav_t *grav, bool *gameover, bool *exit) {
-	SDL_Event	event;
-	bool 		quit		= false;
-	unsigned	lines;					// Number of full lines
-	unsigned	dist;					// Distance of hard drop
-
-	assert(move != NULL && grav != NULL && gameover != NULL && exit != NULL);
-	while (SDL_PollEvent(&event)) {
-		switch (event.type) {
-			case SDL_KEYDOWN:
-				switch (event.key.keysym.sym) {
-					case SDLK_ESCAPE:
-						quit = true;
-						break;
-					case SDLK_LEFT:
-						move->xvel = -1;
-						p_movex(move->xvel);
-						move->xticks = B_MOVETICKS;
-						break;
-					case SDLK_RIGHT:
-						move->xvel = 1;
-						p_movex(move->xvel);
-						move->xticks = B_MOVETICKS;
-						break;
-					case SDLK_UP:
-						p_rot(1);
-						break;
-					case SDLK_DOWN:
-						move->yticks = B_MOVETICKS;
-						break;
-					case SDLK_SPACE:
-						lines = p_harddrop(gameover, &dist);
-						if (lines > 0) {
-							s_award(lines, B_LEV(grav->diff), dist, BD_H);
-						}
-						break;
-					default:
-						// VOID
-						break;
-				}
-				break;
-			case SDL_KEYUP:
-				switch (event.key.keysym.sym) {
-					case SDLK_LEFT:
-						if (move->xvel < 0) {
-							move->xvel = move->xticks = 0;
-						}
-						break;
-					case SDLK_RIGHT:
-						if (move->xvel > 0) {
-							move->xvel = move->xticks = 0;
-						}
-						break;
-					case SDLK_DOWN:
-						move->yticks = 0;
-						break;
-					default:
-						// VOID
-						break;
-				}
-				break;
-			case SDL_QUIT:
-				quit = *exit = true;
-				break;
-			default:
-				// VOID
-				break;
+b_replayall(void) {
+	static bloc_game_t game;
+	const g_event_t *ev;			// Key to apply
+	bool gameover;
+	unsigned ticks;					// Ticks run before the games
+	Uint64 start;					// Time, in ns, the games started
+	double secs;
+
+	ticks = b_stats.ticks;
+	start = ck_now();
+	do {
+		b_usesetup(&b_rec.setup);
+		b_initgame(&game);
+		gameover = false;
+		for (unsigned i = 0; i < b_rec.nkeys && !gameover; i++) {
+			ev = &b_rec.keys[i];
+			while (ev->time >= game.time + G_TICKPART && !gameover) {
+				b_tick(&game, &gameover);
+			}
+			if (!gameover) {
+				g_key(&game, ev, &gameover);
+			}
 		}
+		while (game.time < b_rec.ticks * G_TICKPART && !gameover) {
+			b_tick(&game, &gameover);
+		}
+		b_checkreplay(&game, gameover);
+	} while (rp_load(b_replay.fp, b_opts.replay, &b_rec));
+	ticks = b_stats.ticks - ticks;
+	secs = (double) (ck_now() - start) / CK_SEC;
+	if (secs <= 0) {
+		secs = 1.0 / CK_SEC;
 	}
-	return quit;
+	printf("%u games, %u failed, %u ticks, %.3f s, %.0f ticks/s\n", 
+			b_replay.games, b_replay.failed, ticks, secs, ticks / secs);
+	return b_replay.failed == 0;
 }
 
 /*
- *	Control piece's movement, both user and gravity.
- *	move->xticks	- countdown is decremented and reset, if necessary
- *	move->yticks	- countdown is decremented and reset, if necessary
- *	grav->diffticks - countdown is decremented and reset, if necessary
- *	grav->diff		- difficulty is increased if gravity countdown hits zero
- *	gameover 		- set to true if gravity results in game over
+ *	Check a game played back ended as it was recorded, printing an error if 
+ *	it didn't.
+ *	gameover	- true if the game played back ended by game over
  */
 void
-b_move(b_move_t *move, b_grav_t *grav, bool *gameover) {
-	unsigned lines;		// Number of full lines
+b_checkreplay(const bloc_game_t *game, bool gameover) {
+	assert(game != NULL);
+	b_replay.games++;
+	if (!rp_check(&b_rec, game, gameover)) {
+		b_replay.failed++;
+		fprintf(stderr, "Error: replay game %u ended at tick %lu with score "
+				"%lu, recorded tick %lu score %lu\n", b_replay.games, 
+				(unsigned long) (game->time / G_TICKPART), s_get(game), 
+				(unsigned long) b_rec.ticks, b_rec.score);
+	}
+}
 
-	assert(move != NULL && grav != NULL && gameover != NULL);
-	if (move->xticks > 0) {
-		if (--move->xticks == 0) {
-			p_movex(move->xvel);
-			move->xticks = B_MOVETICKS;
-		}
+/*
+ *	Get the settings the next game will start with, to record them.
+ */
+void
+b_getsetup(rp_setup_t *setup) {
+	assert(setup != NULL);
+	setup->seed = b_opts.seed;
+	setup->w = b_opts.w;
+	setup->h = b_opts.h;
+	setup->rate = b_opts.rate;
+	setup->gravity = b_opts.gravity;
+	setup->bag = b_opts.bag;
+	if (b_opts.shapes == NULL) {
+		setup->shapes[0] = '\0';
+	} else if (strlen(b_opts.shapes) < RP_MAXNAME) {
+		strcpy(setup->shapes, b_opts.shapes);
+	} else {
+		b_error("Error: shapes name too long to record\n");
+	}
+}
+
+/*
+ *	Start the next game with the settings of a recorded game.  The shapes 
+ *	are loaded once, so every game played back must use the same ones.
+ */
+void
+b_usesetup(const rp_setup_t *setup) {
+	assert(setup != NULL);
+	if (strcmp(setup->shapes, b_replay.shapes) != 0 
+	||  setup->bag != b_opts.bag) {
+		b_error("Error: games in replay file %s use different shapes\n", 
+				b_opts.replay);
+	}
+	b_opts.seed = setup->seed;
+	b_opts.w = setup->w;
+	b_opts.h = setup->h;
+	b_opts.rate = (int) setup->rate;
+	b_opts.gravity = setup->gravity;
+}
+
+/*
+ *	Make the link to the other player of a versus game.  The host's 
+ *	settings are used for the game, so the player joining only needs to use 
+ *	the same shapes.  The seed is fixed once sent so both games deal the 
+ *	same pieces.
+ */
+void
+b_connect(void) {
+	rp_setup_t setup;		// Settings the game starts with
+
+	b_vs.link.fd = -1;
+	if (b_opts.host != NULL) {
+		b_vsfits();
+		b_setseed();
+		b_opts.seeded = true;
+		b_getsetup(&setup);
+		nt_host(&b_vs.link, b_opts.host, (unsigned) b_opts.lag, &setup);
+		b_vs.me = 0;
+		return;
+	}
+	nt_join(&b_vs.link, b_opts.join, (unsigned) b_opts.lag, &setup);
+	if (strcmp(setup.shapes, (b_opts.shapes == NULL) ? "" : b_opts.shapes) != 0
+	||  setup.bag != b_opts.bag) {
+		b_error("Error: the other player uses different shapes\n");
+	}
+	b_opts.seed = setup.seed;
+	b_opts.seeded = true;
+	b_opts.w = setup.w;
+	b_opts.h = setup.h;
+	b_opts.rate = (int) setup.rate;
+	b_opts.gravity = setup.gravity;
+	b_vsfits();
+	b_vs.me = 1;
+}
+
+/*
+ *	Exit if the board is too big for a versus game, every tick's state must 
+ *	fit in a snapshot.
+ */
+void
+b_vsfits(void) {
+	if (b_opts.w * b_opts.h > BD_SNAPCELLS || b_opts.h > BD_SNAPH) {
+		b_error("Error: a versus board can have at most %d blocks and %d "
+				"lines\n", BD_SNAPCELLS, BD_SNAPH);
 	}
-	if (move->yticks > 0 && B_MOVETICKS < grav->diff) {
+}
+
+/*
+ *	Print how often the versus game went back and how fast it ran the 
+ *	ticks again, with the hashes of both games so the two players can check 
+ *	they ended the same.
+ */
+void
+b_vsreport(void) {
+	double secs;
+
+	secs = (double) b_vs.rerunns / CK_SEC;
+	printf("%lu ticks, %u rollbacks, %u ticks run again, deepest %u, "
+			"%.0f ticks/s run again\n", (unsigned long) b_vs.tick, 
+			b_vs.rollbacks, b_vs.rerun, b_vs.deepest, 
+			(secs > 0) ? b_vs.rerun / secs : 0.0);
+	printf("%s hashes %llx %llx\n", (b_vs.result != NULL) ? b_vs.result : "",
+			(unsigned long long) b_vs.games[0].hash, 
+			(unsigned long long) b_vs.games[1].hash);
+}
+
+/*
+ *	Run one game tick: move the game time on, repeat held sideways keys, 
+ *	move the piece and remove lines.
+ */
+void
+b_tick(bloc_game_t *game, bool *gameover) {
+	assert(game != NULL && gameover != NULL);
+	game->time += G_TICKPART;
+	b_stats.ticks++;
+	g_repeat(game, game->time);
+	b_move(game, gameover);
+	bd_chkrm(game);
+}
+
+/*
+ *	Control piece's soft drop and gravity.  Gravity adds its speed to the 
+ *	part of a cell the piece has fallen each tick and the piece drops a cell 
+ *	for each whole cell, so it can fall several cells in one tick.  A piece 
+ *	that lands stops there for the tick and locks on its next drop.
+ *	game->move.yticks		- countdown is decremented and reset, if necessary
+ *	game->grav.fall			- speed is added and whole cells dropped
+ *	game->grav.diffticks	- countdown is decremented and reset, if necessary
+ *	game->grav.diff			- difficulty is increased if gravity countdown 
+ *							  hits zero
+ *	gameover 				- set to true if gravity results in game over
+ */
+void
+b_move(bloc_game_t *game, bool *gameover) {
+	unsigned lines;		// Number of full lines
+	bool resting;		// Piece has landed
+	b_move_t *move;		// Game piece's movement
+	b_grav_t *grav;		// Game piece's gravity
+
+	assert(game != NULL && gameover != NULL);
+	move = &game->move;
+	grav = &game->grav;
+	if (b_issoft(game)) {
 		if (--move->yticks == 0) {
-			lines = p_movey(1, gameover);
+			lines = p_movey(game, 1, gameover);
 			if (lines > 0) {
-				s_award(lines, B_LEV(grav->diff), 0, BD_H);
+				s_award(game, lines, G_LEV(grav->diff), 0, game->board.h);
 			}
-			move->yticks = B_MOVETICKS;
+			move->yticks = g_ticks(game, G_SOFTMS);
 		}
-	} else if (--grav->dropticks == 0) {
-		lines = p_movey(1, gameover);
-		if (lines > 0) {
-			s_award(lines, B_LEV(grav->diff), 0, BD_H);
+	} else {
+		grav->fall += grav->speed;
+		while (grav->fall >= B_CELL && !*gameover) {
+			grav->fall -= B_CELL;
+			resting = p_isresting(game);
+			lines = p_movey(game, 1, gameover);
+			if (lines > 0) {
+				s_award(game, lines, G_LEV(grav->diff), 0, game->board.h);
+			}
+			if (resting) {
+				grav->fall = 0;
+			} else if (p_isresting(game)) {
+				grav->fall %= B_CELL;
+			}
 		}
-		grav->dropticks = grav->diff;
 	}
 	if (--grav->diffticks == 0) {
 		if (grav->diff > 1) {
 			grav->diff--;
+			b_setspeed(game);
 		}
-		grav->diffticks = B_DIFFTICKS;
+		grav->diffticks = g_ticks(game, B_DIFFMS);
+	}
+}
+
+/*
+ *	Returns true if the piece is being soft dropped, only while the key is 
+ *	held and soft drop is faster than gravity.
+ */
+bool
+b_issoft(const bloc_game_t *game) {
+	assert(game != NULL);
+	return game->move.yticks > 0 
+		&& B_CELL / g_ticks(game, G_SOFTMS) > game->grav.speed;
+}
+
+/*
+ *	Draw a frame of the game.
+ *	part	- part of the next tick gone, in 16.16 fixed point
+ */
+void
+b_draw(const b_frame_t *frame, Uint32 part) {
+	const bloc_game_t *game;
+
+	assert(frame != NULL);
+	game = &frame->game;
+	b_drawbg(b_screen, b_game);
+	bd_draw(game, b_screen, b_blocks);
+	p_draw(game, b_screen, b_blocks, b_fall(game, part));
+	b_drawinfo(game);
+	if (b_opts.debug) {
+		b_drawstats(&frame->stats);
+	}
+	if (frame->foe.on) {
+		b_drawfoe(&frame->foe);
+	}
+	b_update(b_screen);
+}
+
+/*
+ *	Returns how far the falling piece has got towards the next block down, 
+ *	in 16.16 fixed point, part of the way through the next tick.  This is 
+ *	the soft drop's countdown, or gravity's part of a cell plus the part of 
+ *	its speed for the time gone.  A piece that has landed isn't moved.
+ *	part	- part of the next tick gone, in 16.16 fixed point
+ */
+Uint32
+b_fall(const bloc_game_t *game, Uint32 part) {
+	const b_grav_t *grav;	// Game piece's gravity
+	unsigned moveticks;		// Game ticks between movements
+	Uint32 fall;
+
+	assert(game != NULL);
+	grav = &game->grav;
+	if (p_isresting(game)) {
+		return 0;
+	}
+	if (b_issoft(game)) {
+		moveticks = g_ticks(game, G_SOFTMS);
+		fall = ((moveticks - game->move.yticks) * B_CELL + part) / moveticks;
+	} else {
+		fall = grav->fall + (Uint32) (((Uint64) grav->speed * part) >> 16);
+	}
+	return MIN(fall, B_CELL - 1);
+}
+
+/*
+ *	Set the speed of gravity, either the fixed gravity given on the command 
+ *	line or a drop every B_DROPMS for each step of difficulty.  Speeds are 
+ *	rounded up so a level never falls slower than it did at the default rate.
+ */
+void
+b_setspeed(bloc_game_t *game) {
+	Uint64 speed;	// Cells per tick, in 16.16 fixed point
+
+	assert(game != NULL);
+	if (b_opts.gravity > 0.0) {
+		speed = (Uint64) (b_opts.gravity * B_CELL * 60 / game->rate + 0.5);
+	} else {
+		speed = ((Uint64) B_CELL * 1000 + game->grav.diff * B_DROPMS * 
+				game->rate - 1) / (game->grav.diff * B_DROPMS * game->rate);
 	}
+	game->grav.speed = (Uint32) MAX(speed, 1);
 }
 
 /*
  *	Draw the score and level.
- *	grav - required to get current difficulty
+ *	game - game to get the current difficulty and score from
  */
 void
-b_drawinfo(const b_grav_t *grav) {
-	assert(grav != NULL);
+b_drawinfo(const bloc_game_t *game) {
+	assert(game != NULL);
 	bf_printf(b_screen, b_font, B_INFOX, B_INFOY,
-			"Level:\n%*d\n\nScore:\n%*d", B_INFOW, B_LEV(grav->diff),
-			B_INFOW, s_get());
+			"Level:\n%*d\n\nScore:\n%*d", B_INFOW, G_LEV(game->grav.diff),
+			B_INFOW, s_get(game));
+}
+
+/*
+ *	Draw the logic pacing counters and the mean wake up jitter.
+ *	stats	- counters published with the frame
+ */
+void
+b_drawstats(const b_stats_t *stats) {
+	ck_jitter_t jitter;		// How late waits have woken
+
+	assert(stats != NULL);
+	ck_getjitter(&jitter);
+	bf_printf(b_screen, b_font, B_DEBUGX, B_DEBUGY,
+			"Overruns:\n%*u\nCapped:\n%*u\nDrift ms:\n%*u\n"
+			"Jitter us:\n%*lu", 
+			B_INFOW, stats->overruns, B_INFOW, stats->capped, B_INFOW, 
+			stats->drift, B_INFOW, (jitter.waits > 0) 
+			? (unsigned long) (jitter.total / jitter.waits / CK_US) : 0UL);
+}
+
+/*
+ *	Draw the other player's score and lines, and the garbage lines they 
+ *	have sent that are still to come.
+ */
+void
+b_drawfoe(const b_foe_t *foe) {
+	assert(foe != NULL);
+	bf_printf(b_screen, b_font, B_INFOX, B_FOEY,
+			"Opponent:\n%*lu\nLines:\n%*u\nGarbage:\n%*u", B_INFOW, 
+			foe->score, B_INFOW, foe->lines, B_INFOW, foe->owed);
+}
+
+/*
+ *	Write the pacing counters to the debug file, once no game is running.
+ */
+void
+b_savestats(void) {
+	FILE *fp;				// Debug file
+	ck_jitter_t jitter;		// How late waits have woken
+
+	ck_getjitter(&jitter);
+	fp = fopen(B_DEBUGFILE, B_WRITEONLY);
+	if (fp == NULL) {
+		fprintf(stderr, "Error opening debug file %s for writing\n", 
+				B_DEBUGFILE);
+		return;
+	}
+	fprintf(fp, "ticks\t%u\nframes\t%u\noverruns\t%u\ncapped\t%u\n"
+			"drift_ms\t%lu\n", b_stats.ticks, b_drawn, b_stats.overruns, 
+			b_stats.capped, (unsigned long) b_stats.drift);
+	fprintf(fp, "spin_us\t%d\nwaits\t%lu\njitter_mean_us\t%lu\n"
+			"jitter_max_us\t%lu\n", b_opts.spin, 
+			(unsigned long) jitter.waits, (jitter.waits > 0) 
+			? (unsigned long) (jitter.total / jitter.waits / CK_US) : 0UL, 
+			(unsigned long) (jitter.max / CK_US));
+	if (ferror(fp)) {
+		fprintf(stderr, "Error writing debug file %s\n", B_DEBUGFILE);
+	}
+	if (fclose(fp) == EOF) {
+		fprintf(stderr, "Error closing debug file %s\n", B_DEBUGFILE);
+	}
 }
 
 /*
@@ -528,6 +2102,8 @@ b_init(void) {
 	if (SDL_Init(flags) == -1) {
 		b_error("Error initialising SDL: %s\n", SDL_GetError());
 	}
+	// Nothing uses the mouse, don't wake up for it
+	SDL_EventState(SDL_MOUSEMOTION, SDL_IGNORE);
 	flags = IMG_INIT_PNG;
 	if ((IMG_Init(flags) & flags) != flags) {
 		b_error("Error initialising SDL_image: %s\n", IMG_GetError());
@@ -555,11 +2131,196 @@ b_init(void) {
 }
 
 /*
- *	Set the initial seed by getting the current time.
+ *	Set up a new game: zero the score, clear the board, get the first pieces 
+ *	and reset the piece's movement and gravity.  Each game's pieces come 
+ *	from the next seed, so a run started with the same seed deals the same 
+ *	pieces.
+ */
+void
+b_initgame(bloc_game_t *game) {
+	assert(game != NULL);
+	game->rate = b_opts.rate;
+	game->time = 0;
+	s_init(game);
+	bd_init(game, b_opts.w, b_opts.h);
+	rng_seed(&game->rng, b_opts.seed++);
+	p_init(game);
+	game->move.xvel = 0;
+	game->move.xtime = 0;
+	game->move.yticks = 0;
+	game->grav.diff = G_GRAVTICKS;
+	game->grav.fall = 0;
+	game->grav.diffticks = g_ticks(game, B_DIFFMS);
+	b_setspeed(game);
+}
+
+/*
+ *	Set the first game's seed from the current time, unless it was given on 
+ *	the command line.
  */
 void
 b_setseed(void) {
-	srand((unsigned int) time(NULL));
+	if (!b_opts.seeded) {
+		b_opts.seed = (Uint64) time(NULL);
+	}
+}
+
+/*
+ *	Read the command line options.  Prints usage and exits if an option is 
+ *	not recognised or --headless is given with an option for the window.  
+ *	Exits if --watch is given without --replay.
+ *	--width n		- board width, in blocks
+ *	--height n		- board height, in blocks
+ *	--shapes name	- shape set or shapes file
+ *	--seed n		- seed for the first game's pieces
+ *	--bag			- deal shapes from a bag
+ *	--perft depth	- count placements instead of playing
+ *	--rate hz		- game ticks per second
+ *	--gravity g		- fixed gravity, in cells per 1/60 s
+ *	--fps n			- most frames drawn per second, 0 for no limit
+ *	--spin us		- time spun before each tick or frame, 0 to only sleep
+ *	--debug			- show the frame pacing counters and save them on exit
+ *	--headless games	- have the bot play games without a window
+ *	--pieces n		- most pieces in a headless game
+ *	--record file	- add every game played to the file
+ *	--replay file	- play back the games in the file and check them
+ *	--watch			- play the games back in the window at normal speed
+ *	--host addr		- host a versus game at [host:]port or a socket path
+ *	--join addr		- join a versus game at [host:]port or a socket path
+ *	--lag ms		- latency added to the keys sent in a versus game
+ *	--share file	- share the game's state with other processes in the file
+ *	--bot command	- run the command as a bot to play the game
+ */
+void
+b_args(int argc, char *argv[]) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+			b_opts.w = b_argint(argv[0], argv[++i], BD_MINW, BD_MAXW);
+		} else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+			b_opts.h = b_argint(argv[0], argv[++i], BD_MINH, BD_MAXH);
+		} else if (strcmp(argv[i], "--shapes") == 0 && i + 1 < argc) {
+			b_opts.shapes = argv[++i];
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			b_opts.seed = b_argseed(argv[0], argv[++i]);
+			b_opts.seeded = true;
+		} else if (strcmp(argv[i], "--bag") == 0) {
+			b_opts.bag = true;
+		} else if (strcmp(argv[i], "--perft") == 0 && i + 1 < argc) {
+			b_opts.perft = b_argint(argv[0], argv[++i], 1, PF_MAXDEPTH);
+		} else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+			b_opts.rate = b_argint(argv[0], argv[++i], B_MINRATE, B_MAXRATE);
+		} else if (strcmp(argv[i], "--gravity") == 0 && i + 1 < argc) {
+			b_opts.gravity = b_arggrav(argv[0], argv[++i]);
+		} else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+			b_opts.fps = b_argint(argv[0], argv[++i], 0, B_MAXFPS);
+		} else if (strcmp(argv[i], "--spin") == 0 && i + 1 < argc) {
+			b_opts.spin = b_argint(argv[0], argv[++i], 0, 
+					(int) (CK_MAXSPIN / CK_US));
+		} else if (strcmp(argv[i], "--debug") == 0) {
+			b_opts.debug = true;
+		} else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+			b_opts.headless = b_argint(argv[0], argv[++i], 1, INT_MAX);
+		} else if (strcmp(argv[i], "--pieces") == 0 && i + 1 < argc) {
+			b_opts.pieces = b_argint(argv[0], argv[++i], 1, INT_MAX);
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			b_opts.record = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			b_opts.replay = argv[++i];
+		} else if (strcmp(argv[i], "--watch") == 0) {
+			b_opts.watch = true;
+		} else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+			b_opts.host = argv[++i];
+		} else if (strcmp(argv[i], "--join") == 0 && i + 1 < argc) {
+			b_opts.join = argv[++i];
+		} else if (strcmp(argv[i], "--lag") == 0 && i + 1 < argc) {
+			b_opts.lag = b_argint(argv[0], argv[++i], 0, NT_MAXLAG);
+		} else if (strcmp(argv[i], "--share") == 0 && i + 1 < argc) {
+			b_opts.share = argv[++i];
+		} else if (strcmp(argv[i], "--bot") == 0 && i + 1 < argc) {
+			b_opts.bot = argv[++i];
+		} else {
+			b_usage(argv[0]);
+		}
+	}
+	if (b_opts.headless > 0 && (b_opts.replay != NULL || b_opts.watch 
+	||  b_opts.host != NULL || b_opts.join != NULL)) {
+		fprintf(stderr, "Error: --headless can't be used with --replay, "
+				"--watch, --host or --join\n");
+		b_usage(argv[0]);
+	}
+	if (b_opts.watch && b_opts.replay == NULL) {
+		b_error("Error: --watch needs --replay\n");
+	}
+}
+
+/*
+ *	Returns the value of a numeric option.  Prints usage and exits if it is 
+ *	not a number between min and max.
+ */
+int
+b_argint(const char *prog, const char *arg, int min, int max) {
+	char *end;		// First character after the number
+	long n;
+
+	assert(prog != NULL && arg != NULL);
+	errno = 0;
+	n = strtol(arg, &end, 10);
+	if (errno == ERANGE || end == arg || *end != '\0' || n < min || n > max) {
+		fprintf(stderr, "Error: %s is not a number from %d to %d\n", arg, min, 
+				max);
+		b_usage(prog);
+	}
+	return (int) n;
+}
+
+/*
+ *	Returns the value of the seed option.  Prints usage and exits if it is 
+ *	not a number.
+ */
+Uint64
+b_argseed(const char *prog, const char *arg) {
+	char *end;		// First character after the number
+	unsigned long long n;
+
+	assert(prog != NULL && arg != NULL);
+	errno = 0;
+	n = strtoull(arg, &end, 0);
+	if (errno == ERANGE || end == arg || *end != '\0') {
+		fprintf(stderr, "Error: %s is not a seed\n", arg);
+		b_usage(prog);
+	}
+	return (Uint64) n;
+}
+
+/*
+ *	Returns the value of the gravity option.  Prints usage and exits if it is 
+ *	not a number above 0 and up to B_MAXGRAV.
+ */
+double
+b_arggrav(const char *prog, const char *arg) {
+	char *end;		// First character after the number
+	double g;
+
+	assert(prog != NULL && arg != NULL);
+	errno = 0;
+	g = strtod(arg, &end);
+	if (errno == ERANGE || end == arg || *end != '\0' || !(g > 0.0) 
+	||  g > B_MAXGRAV) {
+		fprintf(stderr, "Error: %s is not a gravity above 0 and up to %d\n", 
+				arg, B_MAXGRAV);
+		b_usage(prog);
+	}
+	return g;
+}
+
+/*
+ *	Print usage and exit with status EXIT_FAILURE.
+ */
+void
+b_usage(const char *prog) {
+	assert(prog != NULL);
+	fprintf(stderr, B_USAGE, prog);
+	exit(EXIT_FAILURE);
 }
 
 /*
@@ -567,12 +2328,63 @@ b_setseed(void) {
  */
 int
 main(int argc, char *argv[]) {
-	if (argc > 1) {
-		fprintf(stderr, "Error: %s takes no parameters\n", argv[0]);
+	bool ok;	// Every game replayed ended as recorded
+
+	b_args(argc, argv);
+	if (b_opts.replay != NULL) {
+		b_replay.fp = rp_open(b_opts.replay);
+		if (!rp_load(b_replay.fp, b_opts.replay, &b_rec)) {
+			b_error("Error: no games in replay file %s\n", b_opts.replay);
+		}
+		strcpy(b_replay.shapes, b_rec.setup.shapes);
+		b_opts.shapes = (b_replay.shapes[0] == '\0') ? NULL : b_replay.shapes;
+		b_opts.bag = b_rec.setup.bag;
+	}
+	p_loadshapes(b_opts.shapes);
+	p_usebag(b_opts.bag);
+	if (b_opts.w < p_size() || b_opts.h < p_size()) {
+		b_error("Error: board is smaller than the shapes, %dx%d\n", p_size(), 
+				p_size());
+	}
+	if (b_opts.perft > 0) {
+		pf_run(b_opts.w, b_opts.h, b_opts.perft);
+		exit(EXIT_SUCCESS);
 	}
+	if (b_opts.share != NULL) {
+		sh_open(b_opts.share);
+	}
+	if (b_opts.bot != NULL) {
+		xb_start(b_opts.bot);
+	}
+	if (b_opts.headless > 0) {
+		b_setseed();
+		b_headless();
+		b_cleanup();
+		exit(EXIT_SUCCESS);
+	}
+	if (b_opts.replay != NULL && !b_opts.watch) {
+		ok = b_replayall();
+		b_cleanup();
+		exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	if (b_opts.host != NULL || b_opts.join != NULL) {
+		b_connect();
+	}
+	ck_setspin((Uint64) b_opts.spin * CK_US);
 	b_init();
-	m_display(b_screen, b_menu, b_font, b_blocks, B_GAMEX, B_GAMEY);
-	s_save();
+	if (b_opts.replay != NULL) {
+		b_run(B_WATCH);
+		printf("%u games, %u failed\n", b_replay.games, b_replay.failed);
+	} else if (b_opts.host != NULL || b_opts.join != NULL) {
+		b_run(B_VERSUS);
+		b_vsreport();
+	} else {
+		b_run(B_MENU);
+		s_save();
+	}
+	if (b_opts.debug) {
+		b_savestats();
+	}
 	b_cleanup();
-	exit(EXIT_SUCCESS);
+	exit((b_replay.failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
 }
@@ -19,19 +19,28 @@
 #define B_GAMEH		B_SCRH - B_GAMEY
 
 #define MIN(x, y)	(((x) < (y)) ? (x) : (y))
+#define MAX(x, y)	(((x) > (y)) ? (x) : (y))
 
-// Which keys to wait for?
-typedef enum { B_RETURNONLY = 1, B_ANYKEY } b_waitkey_t;
+// Atomic loads, stores, swaps and fences, for data shared between threads
+#define B_LOAD(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define B_STORE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define B_SWAP(p, v)	__atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#define B_ADD(p, v)		__atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define B_FENCE()		__atomic_thread_fence(__ATOMIC_RELEASE)
+
+// Scenes the main loop can run, B_STAY means stay in the current scene
+typedef enum { 
+	B_STAY = 0, B_MENU, B_GAME, B_INTRO, B_SCORES, B_OVER, B_NAME, B_WATCH, 
+	B_VERSUS, B_RESULT, B_EXIT
+} b_sceneid_t;
+
+// State of a single game, see game.h
+typedef struct bloc_game bloc_game_t;
 
 // Function prototypes
-extern bool b_newgame(void);
-extern bool b_intro(void);
-extern bool b_scores(void);
 extern void b_drawbg(SDL_Surface *screen, SDL_Surface *bg);
 extern void b_update(SDL_Surface *screen);
 extern char *b_strdup(const char *s);
-extern Uint32 b_delaylen(Uint32 next);
 extern void b_error(const char *msg, ...);
-extern bool b_waitkey(b_waitkey_t keys);
 
 #endif // BLOC_H
@@ -6,65 +6,114 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <string.h>
 #include "SDL.h"
 #include "bloc.h"
 #include "board.h"
+#include "piece.h"
+#include "rng.h"
+#include "score.h"
+#include "game.h"
+#include "tt.h"
 
 #define BD_BGX			24		// Boards position on background bitmap
 #define BD_BGY			144
 #define BD_BLKW			24		// Dimensions of block sprite
 #define BD_BLKH			24
-#define BD_LINETICKS	20		// Number of ticks till full line is removed
-#define BD_ANIMDIV		4		// How often line is flashed
+#define BD_LINEMS		400		// Time till full line is removed, in ms
+#define BD_ANIMMS		80		// How often line is flashed
+#define BD_BIT(x)		(((bd_row_t) 1) << (x))		// Block's bit in a row
+#define BD_KEY(y)		((Uint64) (y))		// Line's hash key
+// Hash key of a row of blocks on the line with the given key
+#define BD_ROWKEY(row, key)	(((row) != 0) ? tt_key((row) ^ (key)) : 0)
 
-/*
- *	The game board is a two-dimensional array of coloured blocks.
- */
-static bd_col_t brd[BD_H][BD_W];
+// Function prototypes
+static unsigned bd_rmlines(bloc_game_t *game, bool full);
+static void bd_setheights(bd_board_t *brd);
+static Uint64 bd_rowkey(int y, bd_row_t row);
+static bd_col_t bd_getcol(const bd_board_t *brd, int x, int y);
+static void bd_putbits(Uint64 *words, int pos, int len, bd_row_t bits);
+static bd_row_t bd_getbits(const Uint64 *words, int pos, int len);
 
 /*
- *	Line is removed once its ticks reaches zero, animation is based on number 
- *	of ticks left.
- */
-static unsigned lineticks[BD_H];
-
-/*
- *	Copy the block to the board at the given position.
+ *	Copy a row of blocks to the board, all of the given colour.  The line's 
+ *	fill count, the columns' heights and the game's hash are updated to 
+ *	match.
+ *	y		- line to copy to
+ *	blocks	- blocks to copy, one bit for each column, must be clear
  */
 void 
-bd_copytobd(int x, int y, bd_col_t col) {
-	brd[y][x] = col;
+bd_copytobd(bloc_game_t *game, int y, bd_row_t blocks, bd_col_t col) {
+	bd_board_t *brd;
+	Uint64 key;	// Line's hash key
+	int r;		// Where the line is stored
+
+	assert(game != NULL && col != CLEAR);
+	brd = &game->board;
+	r = brd->map[y];
+	assert((brd->rows[r] & blocks) == 0 && (blocks & ~brd->full) == 0);
+	key = tt_key(BD_KEY(y));
+	game->hash ^= BD_ROWKEY(brd->rows[r], key) 
+		^ BD_ROWKEY(brd->rows[r] | blocks, key);
+	brd->rows[r] |= blocks;
+	for (int k = 0; k < BD_COLBITS; k++) {
+		if ((col >> k) & 1) {
+			brd->colplane[r][k] |= blocks;
+		} else {
+			brd->colplane[r][k] &= ~blocks;
+		}
+	}
+	for (int i = 0; blocks != 0; i++, blocks >>= 1) {
+		if (blocks & 1) {
+			brd->fill[r]++;
+			if (brd->height[i] < brd->h - y) {
+				brd->height[i] = brd->h - y;
+			}
+		}
+	}
 }
 
 /*
  *	Returns true if the given block is not clear.
  */
 bool
-bd_iscollide(int x, int y) {
-	return brd[y][x] != CLEAR;
+bd_iscollide(const bloc_game_t *game, int x, int y) {
+	assert(game != NULL);
+	return (game->board.rows[game->board.map[y]] & BD_BIT(x)) != 0;
+}
+
+/*
+ *	Returns the row of the highest block in the given column, the board's 
+ *	height if the column is empty.
+ */
+int
+bd_top(const bloc_game_t *game, int x) {
+	assert(game != NULL);
+	return game->board.h - game->board.height[x];
 }
 
 /*
  *	Check board for full lines and start the counter for animation and line 
- *	removal.  Returns the number of full lines.
- *	start	- line to start checking from
+ *	removal.  Uses the fill count, so only the given rows are looked at.  
+ *	Returns the number of full lines.
+ *	start	- line to start checking from, may be above the board
  *	end		- line to stop checking on
  */
 unsigned
-bd_chkfull(unsigned start, unsigned end) {
-	bool isfull;			// Is this a full line?
+bd_chkfull(bloc_game_t *game, int start, int end) {
+	bd_board_t *brd;
 	unsigned lines = 0;		// Number of full line
+	int r;					// Where the line is stored
 
-	for (unsigned j = start; j <= MIN(end, BD_H - 1); j++) {
-		isfull = true;
-		for (unsigned i = 0; i < BD_W; i++) {
-			if (brd[j][i] == CLEAR) {
-				isfull = false;
-				break;
+	assert(game != NULL);
+	brd = &game->board;
+	for (int j = MAX(start, 0); j <= MIN(end, brd->h - 1); j++) {
+		r = brd->map[j];
+		if (brd->fill[r] == brd->w) {
+			if (brd->lineticks[r] == 0) {
+				brd->pending++;
 			}
-		}
-		if (isfull) {
-			lineticks[j] = BD_LINETICKS;
+			brd->lineticks[r] = g_ticks(game, BD_LINEMS);
 			lines++;
 		}
 	}
@@ -76,96 +125,237 @@ bd_chkfull(unsigned start, unsigned end) {
  *	zero.
  */
 void 
-bd_chkrm(void) {
-	int skip = 0;	// Number of lines to skip when moving lines down
-
-	for (int j = BD_H - 1; j >= skip; j--) {
-		for (int k = j - skip; k >= skip; k--) {
-			if (lineticks[k] > 0 && --lineticks[k] == 0) {
-				skip++;
-			} else {
-				break;
+bd_chkrm(bloc_game_t *game) {
+	assert(game != NULL);
+	if (game->board.pending > 0) {
+		bd_rmlines(game, false);
+	}
+}
+
+/*
+ *	Remove all full lines straight away, without waiting for them to be 
+ *	animated.  Returns the number of lines removed.
+ */
+unsigned
+bd_flush(bloc_game_t *game) {
+	assert(game != NULL);
+	return bd_rmlines(game, true);
+}
+
+/*
+ *	Push lines of garbage up from the bottom of the board, each full but for
+ *	a gap at the same column.  The lines that go off the top become the
+ *	garbage lines, the same way removed lines become the top lines, and the
+ *	hash keys of the lines that move are swapped for their new lines.
+ *	Returns false if any of the lines that went off the top had blocks in.
+ *	lines	- number of lines to push up, less than the board's height
+ *	gap		- column left clear
+ */
+bool
+bd_garbage(bloc_game_t *game, unsigned lines, int gap, bd_col_t col) {
+	bd_board_t *brd;
+	Uint16 freed[BD_MAXH];	// Rows freed by lines going off the top
+	bd_row_t blocks;		// Blocks of a garbage line
+	bool fits = true;
+	int n;
+	int r;					// Where the line is stored
+
+	assert(game != NULL && col != CLEAR);
+	brd = &game->board;
+	assert(lines < (unsigned) brd->h && gap >= 0 && gap < brd->w);
+	n = (int) lines;
+	for (int j = 0; j < brd->h; j++) {
+		r = brd->map[j];
+		if (j < n) {
+			if (brd->rows[r] != 0) {
+				fits = false;
+				game->hash ^= bd_rowkey(j, brd->rows[r]);
+				if (brd->lineticks[r] > 0) {
+					brd->pending--;
+				}
 			}
+			freed[j] = r;
+		} else {
+			game->hash ^= bd_rowkey(j, brd->rows[r])
+				^ bd_rowkey(j - n, brd->rows[r]);
+			brd->map[j-n] = r;
+		}
+	}
+	blocks = brd->full & ~BD_BIT(gap);
+	for (int j = 0; j < n; j++) {
+		r = freed[j];
+		brd->map[brd->h-n+j] = r;
+		brd->rows[r] = 0;
+		for (int k = 0; k < BD_COLBITS; k++) {
+			brd->colplane[r][k] = 0;
+		}
+		brd->fill[r] = 0;
+		brd->lineticks[r] = 0;
+		bd_copytobd(game, brd->h - n + j, blocks, col);
+	}
+	bd_setheights(brd);
+	return fits;
+}
+
+/*
+ *	Remove lines from the board.  The lines above a removed line are moved 
+ *	down by moving their entries in the map, the freed rows are cleared and 
+ *	become the top lines.  The hash keys of the lines that move are swapped 
+ *	for their new lines.  Column heights are worked out again if any lines 
+ *	were removed.  Returns the number of lines removed.
+ *	full	- true to remove full lines, false to count down lineticks and 
+ *			  remove lines when they reach zero
+ */
+unsigned
+bd_rmlines(bloc_game_t *game, bool full) {
+	bd_board_t *brd;
+	Uint16 freed[BD_MAXH];	// Rows freed by removed lines
+	int skip = 0;			// Number of lines to skip when moving lines down
+	int r;					// Where the line is stored
+	bool rm;				// Whether to remove the line
+
+	assert(game != NULL);
+	brd = &game->board;
+	for (int j = brd->h - 1; j >= 0; j--) {
+		r = brd->map[j];
+		if (full) {
+			rm = (brd->fill[r] == brd->w);
+		} else {
+			rm = (brd->lineticks[r] > 0 && --brd->lineticks[r] == 0);
 		}
-		if (skip > 0) {
-			for (int i = 0; i < BD_W; i++) {
-				brd[j][i] = brd[j-skip][i];
+		if (rm) {
+			game->hash ^= bd_rowkey(j, brd->rows[r]);
+			freed[skip++] = r;
+			if (!full || brd->lineticks[r] > 0) {
+				brd->pending--;
 			}
-			lineticks[j] = lineticks[j-skip];
+			brd->lineticks[r] = 0;
+		} else if (skip > 0) {
+			game->hash ^= bd_rowkey(j, brd->rows[r]) 
+				^ bd_rowkey(j + skip, brd->rows[r]);
+			brd->map[j+skip] = r;
 		}
 	}
 	for (int j = 0; j < skip; j++) {
-		for (int i = 0; i < BD_W; i++) {
-			brd[j][i] = CLEAR;
-		}
-		lineticks[j] = 0;
-	}
-	/* Working but less efficient algorithm, lines can be moved multiple times:
-	for (int i = 0; i < BD_H; i++) {
-		if (lineticks[i] > 0) {
-			if (--lineticks[i] == 0) {
-				for (int j = i; j >= 0; j--) {
-					for (int k = 0; k < BD_W; k++) {
-						brd[j][k] = brd[j-1][k];
-					}
-					lineticks[j] = lineticks[j-1];
-				}
-				for (int k = 0; k < BD_W; k++) {
-					brd[0][k] = CLEAR;
-				}
-				lineticks[0] = 0;
+		r = freed[j];
+		brd->map[j] = r;
+		brd->rows[r] = 0;
+		for (int k = 0; k < BD_COLBITS; k++) {
+			brd->colplane[r][k] = 0;
+		}
+		brd->fill[r] = 0;
+	}
+	if (skip > 0) {
+		bd_setheights(brd);
+	}
+	return (unsigned) skip;
+}
+
+/*
+ *	Returns the hash key of a row as if it were line y of the board, its 
+ *	blocks mixed with the line's key in one go, so moving a line costs the 
+ *	same however many blocks are in it.  An empty row's key is 0.
+ */
+Uint64
+bd_rowkey(int y, bd_row_t row) {
+	return BD_ROWKEY(row, tt_key(BD_KEY(y)));
+}
+
+/*
+ *	Work out the height of every column by walking down from the top of the 
+ *	board until every column has been seen, a row at a time.
+ */
+void
+bd_setheights(bd_board_t *brd) {
+	bd_row_t seen = 0;	// Columns with a block in or above this row
+	bd_row_t found;		// Columns whose highest block is in this row
+
+	assert(brd != NULL);
+	for (int i = 0; i < brd->w; i++) {
+		brd->height[i] = 0;
+	}
+	for (int j = 0; j < brd->h && seen != brd->full; j++) {
+		found = brd->rows[brd->map[j]] & ~seen;
+		for (int i = 0; found != 0; i++, found >>= 1) {
+			if (found & 1) {
+				brd->height[i] = brd->h - j;
 			}
 		}
+		seen |= brd->rows[brd->map[j]];
 	}
-	*/
 }
 
 /*
  *	Draw the game board, flashes full lines that are about to be removed.
- *	screen - screen surface
- *	blocks - blocks bitmap
+ *	game	- game to draw
+ *	screen	- screen surface
+ *	blocks	- blocks bitmap
  */
 void
-bd_draw(SDL_Surface *screen, SDL_Surface *blocks) {
-	bd_col_t col;
+bd_draw(const bloc_game_t *game, SDL_Surface *screen, SDL_Surface *blocks) {
+	const bd_board_t *brd;
 	bool flash;
+	unsigned anim;	// Ticks between flashes
+	int r;			// Where the line is stored
 
-	assert(screen != NULL && blocks != NULL);
-	for (int j = 0; j < BD_H; j++) {
-		if (lineticks[j] > 0) {
-			flash = (((lineticks[j] - 1) / BD_ANIMDIV) % 2 == 0);
+	assert(game != NULL && screen != NULL && blocks != NULL);
+	brd = &game->board;
+	anim = g_ticks(game, BD_ANIMMS);
+	for (int j = 0; j < brd->h; j++) {
+		r = brd->map[j];
+		if (brd->lineticks[r] > 0) {
+			flash = (((brd->lineticks[r] - 1) / anim) % 2 == 0);
 		} else {
 			flash = false;
 		}
-		for (int i = 0; i < BD_W; i++) {
-			col = brd[j][i];
-			if (col != CLEAR) {
-				bd_drawblk(screen, blocks, col, i, j, flash);
+		for (int i = 0; i < brd->w; i++) {
+			if (brd->rows[r] & BD_BIT(i)) {
+				bd_drawblk(screen, blocks, bd_getcol(brd, i, j), i, j, 0, 
+						flash);
 			}
 		}
 	}
 }
 
+/*
+ *	Returns the colour of the block at the given position by gathering its 
+ *	bits from the colour plane.
+ */
+bd_col_t
+bd_getcol(const bd_board_t *brd, int x, int y) {
+	unsigned col = 0;
+	int r;		// Where the line is stored
+
+	assert(brd != NULL);
+	r = brd->map[y];
+	for (int k = 0; k < BD_COLBITS; k++) {
+		col |= ((brd->colplane[r][k] >> x) & 1) << k;
+	}
+	return (bd_col_t) col;
+}
+
 /*
  *	Returns true if the co-ordinates are off the game board, false otherwise.
  */
 bool
-bd_isoff(int x, int y) {
+bd_isoff(const bloc_game_t *game, int x, int y) {
+	assert(game != NULL);
 	return (x < 0
-		||  x >= BD_W
+		||  x >= game->board.w
 		||  y < 0
-		||  y >= BD_H);
+		||  y >= game->board.h);
 }
 
 /*
  *	Blit a certain colour block at a given position on the board.
  *	screen	- screen surface
  *	blocks	- blocks bitmap
+ *	fall	- part of a block to draw it lower by, in 16.16 fixed point
  *	flash	- true if flash animated block
  */
 void
 bd_drawblk(SDL_Surface *screen, SDL_Surface *blocks, bd_col_t col, int x, 
-		int y, bool flash) {
+		int y, Uint32 fall, bool flash) {
 	SDL_Rect srcrect = {
 		(Sint16) (col - 1) * BD_BLKW,
 		(Sint16) (flash) ? BD_BLKH : 0,
@@ -174,7 +364,7 @@ bd_drawblk(SDL_Surface *screen, SDL_Surface *blocks, bd_col_t col, int x,
 	};
 	SDL_Rect dstrect = {
 		(Sint16) BD_BGX + x * BD_BLKW,
-		(Sint16) BD_BGY + y * BD_BLKH,
+		(Sint16) (BD_BGY + y * BD_BLKH + ((fall * BD_BLKH) >> 16)),
 		0,	// Unused
 		0	// Unused
 	};
@@ -186,13 +376,138 @@ bd_drawblk(SDL_Surface *screen, SDL_Surface *blocks, bd_col_t col, int x,
 }
 
 /*
- *	Clear the board.
+ *	Set the size of the board and clear it.  The game's hash is reset to an 
+ *	empty board, so the pieces must be set up after.
+ *	w	- width, in blocks, BD_MINW to BD_MAXW
+ *	h	- height, in blocks, BD_MINH to BD_MAXH
  */
 void 
-bd_init(void) {
-	for (int j = 0; j < BD_H; j++) {
-		for (int i = 0; i < BD_W; i++) {
-			brd[j][i] = CLEAR;
+bd_init(bloc_game_t *game, int w, int h) {
+	bd_board_t *brd;
+
+	assert(game != NULL);
+	assert(w >= BD_MINW && w <= BD_MAXW && h >= BD_MINH && h <= BD_MAXH);
+	brd = &game->board;
+	brd->w = w;
+	brd->h = h;
+	brd->full = ((bd_row_t) -1) >> (BD_MAXW - w);
+	for (int j = 0; j < h; j++) {
+		brd->map[j] = j;
+		brd->rows[j] = 0;
+		for (int k = 0; k < BD_COLBITS; k++) {
+			brd->colplane[j][k] = 0;
 		}
+		brd->lineticks[j] = 0;
+		brd->fill[j] = 0;
+	}
+	for (int i = 0; i < w; i++) {
+		brd->height[i] = 0;
 	}
+	brd->pending = 0;
+	game->hash = 0;
+}
+
+/*
+ *	Save the board to a snapshot.  Returns false, leaving the snapshot 
+ *	unchanged, if the board is too big for a snapshot.
+ */
+bool
+bd_snapshot(const bloc_game_t *game, bd_snap_t *snap) {
+	const bd_board_t *brd;
+	int r;		// Where the line is stored
+
+	assert(game != NULL && snap != NULL);
+	brd = &game->board;
+	if (brd->h > BD_SNAPH || brd->w * brd->h > BD_SNAPCELLS) {
+		return false;
+	}
+	memset(snap, 0, sizeof(*snap));
+	snap->w = (Uint8) brd->w;
+	snap->h = (Uint8) brd->h;
+	for (int j = 0; j < brd->h; j++) {
+		r = brd->map[j];
+		snap->lineticks[j] = (Uint16) brd->lineticks[r];
+		if (brd->rows[r] == 0) {
+			continue;
+		}
+		bd_putbits(snap->rows, j * brd->w, brd->w, brd->rows[r]);
+		for (int k = 0; k < BD_COLBITS; k++) {
+			bd_putbits(snap->colplane[k], j * brd->w, brd->w, 
+					brd->colplane[r][k]);
+		}
+	}
+	return true;
+}
+
+/*
+ *	Restore the board from a snapshot, the board's size is set from it.  The 
+ *	game's hash is left for g_restore to set.
+ */
+void
+bd_restore(bloc_game_t *game, const bd_snap_t *snap) {
+	bd_board_t *brd;
+
+	assert(game != NULL && snap != NULL);
+	bd_init(game, snap->w, snap->h);
+	brd = &game->board;
+	for (int j = 0; j < brd->h; j++) {
+		brd->lineticks[j] = snap->lineticks[j];
+		if (brd->lineticks[j] > 0) {
+			brd->pending++;
+		}
+		brd->rows[j] = bd_getbits(snap->rows, j * brd->w, brd->w);
+		if (brd->rows[j] == 0) {
+			continue;
+		}
+		for (int k = 0; k < BD_COLBITS; k++) {
+			brd->colplane[j][k] = bd_getbits(snap->colplane[k], j * brd->w, 
+					brd->w);
+		}
+		brd->fill[j] = (Uint8) bd_count(brd->rows[j]);
+	}
+	bd_setheights(brd);
+}
+
+/*
+ *	Store the bits of a line at the given bit position of a packed array.  
+ *	The array must be clear there.
+ *	len		- number of bits, 1 to 64
+ */
+void
+bd_putbits(Uint64 *words, int pos, int len, bd_row_t bits) {
+	int sh = pos % 64;		// Position in the first word
+
+	assert(words != NULL && len > 0 && len <= 64);
+	words[pos / 64] |= bits << sh;
+	if (sh + len > 64) {
+		words[pos / 64 + 1] |= bits >> (64 - sh);
+	}
+}
+
+/*
+ *	Returns the bits of a line from the given bit position of a packed array.
+ *	len		- number of bits, 1 to 64
+ */
+bd_row_t
+bd_getbits(const Uint64 *words, int pos, int len) {
+	int sh = pos % 64;		// Position in the first word
+	bd_row_t bits;
+
+	assert(words != NULL && len > 0 && len <= 64);
+	bits = words[pos / 64] >> sh;
+	if (sh + len > 64) {
+		bits |= words[pos / 64 + 1] << (64 - sh);
+	}
+	return bits & (((bd_row_t) -1) >> (64 - len));
+}
+
+/*
+ *	Returns the number of blocks in a row, counting the bits in parallel.
+ */
+int
+bd_count(bd_row_t row) {
+	row = row - ((row >> 1) & 0x5555555555555555ULL);
+	row = (row & 0x3333333333333333ULL) + ((row >> 2) & 0x3333333333333333ULL);
+	row = (row + (row >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int) ((row * 0x0101010101010101ULL) >> 56);
 }
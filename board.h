@@ -1,7 +1,7 @@
 /*
  *	See LICENSE.txt file for copyright and license details.
  *
- *	Requires: <stdbool.h>, <SDL/SDL.h>
+ *	Requires: <stdbool.h>, <SDL/SDL.h>, "bloc.h"
  *
  *	Definitions for the game board.
  */
@@ -9,24 +9,95 @@
 #ifndef BOARD_H
 #define BOARD_H
 
-#define BD_W		10		// Board size, in blocks
+#define BD_W		10		// Default board size, in blocks
 #define BD_H		20
+#define BD_MINW		4		// Smallest board size, a piece must fit
+#define BD_MINH		4
+#define BD_MAXW		64		// Largest board size, a row must fit in a word
+#define BD_MAXH		512
 #define BD_COLS		8		// Number of colours
+#define BD_COLBITS	3		// Number of bits needed to store a colour
+#define BD_SNAPCELLS	256	// Largest board a snapshot can hold, in blocks
+#define BD_SNAPH	32		// Highest board a snapshot can hold
+#define BD_SNAPWORDS	(BD_SNAPCELLS / 64)
 
 // Block colours, CLEAR means no block
 typedef enum { 
 	CLEAR = 0, BLUE, CYAN, GREEN, PURPLE, RED, ORANGE, YELLOW
 } bd_col_t;
 
+// One row of the board, one bit per block
+typedef Uint64 bd_row_t;
+
+/*
+ *	The game board is a bitboard, each row is a word with a bit set for every 
+ *	block that is not clear.  The colours of the blocks are kept in a 
+ *	separate packed plane, word k of a row holds bit k of the colour of every 
+ *	block in the row.  A line is removed once its ticks reaches zero, 
+ *	animation is based on number of ticks left.  The number of blocks in each 
+ *	row and the height of each column are kept up to date as blocks are 
+ *	added and lines removed, so full lines and drop distances can be found 
+ *	without scanning the board.
+ *
+ *	Rows are stored in any order, map gives where each line of the board, 
+ *	counting down from the top, is stored.  Removing lines only moves the 
+ *	entries in map and clears the stored rows that were freed, the rows above 
+ *	are not copied.
+ *
+ *	The board's size is chosen when the game starts.  Every row is one word 
+ *	whatever the width, so a board of any size up to BD_MAXW by BD_MAXH takes 
+ *	the same single-word path for collisions and full lines as the default 
+ *	board does.
+ */
+typedef struct {
+	int			w;								// Board size, in blocks
+	int			h;
+	bd_row_t	full;							// Row with no gaps
+	Uint16		map[BD_MAXH];					// Where each line is stored
+	bd_row_t	rows[BD_MAXH];					// Occupied blocks
+	bd_row_t	colplane[BD_MAXH][BD_COLBITS];	// Colours of the blocks
+	unsigned	lineticks[BD_MAXH];				// Ticks till line is removed
+	Uint8		fill[BD_MAXH];					// Blocks in each row
+	Uint16		height[BD_MAXW];				// Height of each column
+	unsigned	pending;						// Lines to be removed
+} bd_board_t;
+
+/*
+ *	Snapshot of a board, only big enough for small boards so that it can be 
+ *	copied cheaply.  The lines are packed one after the other, w bits each, 
+ *	with the colours packed the same way in separate planes.  Lines are 
+ *	stored in board order so the map isn't needed, and the fill counts, 
+ *	column heights and pending lines are worked out again on restore.
+ */
+typedef struct {
+	Uint64	rows[BD_SNAPWORDS];					// Occupied blocks
+	Uint64	colplane[BD_COLBITS][BD_SNAPWORDS];	// Colours of the blocks
+	Uint16	lineticks[BD_SNAPH];				// Ticks till line is removed
+	Uint8	w;									// Board size, in blocks
+	Uint8	h;
+} bd_snap_t;
+
+// Occupied blocks of line y of the game's board
+#define BD_ROW(game, y)	((game)->board.rows[(game)->board.map[(y)]])
+
 // Function prototypes
-extern void bd_copytobd(int x, int y, bd_col_t col);
-extern bool bd_iscollide(int x, int y);
-extern unsigned bd_chkfull(unsigned start, unsigned end);
-extern void bd_chkrm(void);
-extern void bd_draw(SDL_Surface *screen, SDL_Surface *blocks);
-extern bool bd_isoff(int x, int y);
+extern void bd_copytobd(bloc_game_t *game, int y, bd_row_t blocks, 
+		bd_col_t col);
+extern bool bd_iscollide(const bloc_game_t *game, int x, int y);
+extern int bd_top(const bloc_game_t *game, int x);
+extern unsigned bd_chkfull(bloc_game_t *game, int start, int end);
+extern void bd_chkrm(bloc_game_t *game);
+extern unsigned bd_flush(bloc_game_t *game);
+extern bool bd_garbage(bloc_game_t *game, unsigned lines, int gap, 
+		bd_col_t col);
+extern void bd_draw(const bloc_game_t *game, SDL_Surface *screen, 
+		SDL_Surface *blocks);
+extern bool bd_isoff(const bloc_game_t *game, int x, int y);
 extern void bd_drawblk(SDL_Surface *screen, SDL_Surface *blocks, bd_col_t col, 
-		int x, int y, bool flash);
-extern void bd_init(void);
+		int x, int y, Uint32 fall, bool flash);
+extern void bd_init(bloc_game_t *game, int w, int h);
+extern bool bd_snapshot(const bloc_game_t *game, bd_snap_t *snap);
+extern void bd_restore(bloc_game_t *game, const bd_snap_t *snap);
+extern int bd_count(bd_row_t row);
 
 #endif // BOARD_H
@@ -0,0 +1,175 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Code for the built in bot.  It tries every turn and sideways move of the
+ *	piece followed by a hard drop, the same way the keys would, and keeps
+ *	the move that leaves the best board.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "SDL.h"
+#include "bloc.h"
+#include "board.h"
+#include "piece.h"
+#include "rng.h"
+#include "score.h"
+#include "game.h"
+#include "eval.h"
+#include "bot.h"
+
+#define BT_HEIGHT	51		// Feature weights, the lower the total the better
+#define BT_HOLES	36
+#define BT_BUMP		18
+#define BT_FULL		-76
+
+// Function prototypes
+static bool bt_try(const bloc_game_t *game, bloc_game_t *try,
+		const bt_move_t *move);
+static void bt_best(const ev_batch_t *batch, const bt_move_t *moves,
+		long *best, bt_move_t *move);
+static void bt_press(g_event_t *evs, int *n, g_key_t key, Uint64 time);
+
+/*
+ *	Work out the bot's move for the game piece.  Each move is tried on a
+ *	copy of the game and the boards left are scored a batch at a time.
+ *	Moves that end the game are only made if every move does.
+ *	move	- set to the best move
+ */
+void
+bt_plan(const bloc_game_t *game, bt_move_t *move) {
+	static bloc_game_t try;				// Copy to try each move on
+	static ev_batch_t batch;			// Boards to score
+	bt_move_t moves[EV_BATCH];			// Move for each board in batch
+	Uint64 seen[P_ROTS * (2*BD_MAXW+1)];	// Hashes of the boards tried
+	bt_move_t m;
+	long best = LONG_MAX;				// Lowest score so far
+	int nseen = 0;
+	int i;
+
+	assert(game != NULL && move != NULL);
+	move->rots = 0;
+	move->dx = 0;
+	ev_clear(&batch, game->board.w, game->board.h);
+	for (m.rots = 0; m.rots < P_ROTS; m.rots++) {
+		for (int dir = -1; dir <= 1; dir += 2) {
+			for (int step = (dir < 0) ? 0 : 1; ; step++) {
+				m.dx = dir * step;
+				if (!bt_try(game, &try, &m)) {
+					break;
+				}
+				for (i = 0; i < nseen && seen[i] != try.hash; i++) {
+					// VOID
+				}
+				if (i < nseen) {
+					continue;
+				}
+				seen[nseen++] = try.hash;
+				moves[ev_add(&batch, &try)] = m;
+				if (batch.n == EV_BATCH) {
+					bt_best(&batch, moves, &best, move);
+					ev_clear(&batch, game->board.w, game->board.h);
+				}
+			}
+		}
+	}
+	if (batch.n > 0) {
+		bt_best(&batch, moves, &best, move);
+	}
+}
+
+/*
+ *	Make the move on a copy of the game.  Returns false if the piece can't
+ *	be moved as far sideways as the move says, or the move ends the game.
+ *	try	- set to the game after the move
+ */
+bool
+bt_try(const bloc_game_t *game, bloc_game_t *try, const bt_move_t *move) {
+	bool gameover = false;
+	unsigned dist;			// Distance of hard drop
+	int x;					// Where the piece should end up
+
+	assert(game != NULL && try != NULL && move != NULL);
+	*try = *game;
+	for (int i = 0; i < move->rots; i++) {
+		p_rot(try, 1);
+	}
+	x = try->piece.x + move->dx;
+	for (int i = 0; i < abs(move->dx); i++) {
+		p_movex(try, (move->dx < 0) ? -1 : 1);
+	}
+	if (try->piece.x != x) {
+		return false;
+	}
+	p_harddrop(try, &gameover, &dist);
+	return !gameover;
+}
+
+/*
+ *	Score a batch of boards, keeping the move for the lowest score.
+ *	moves	- move that made each board
+ *	best	- lowest score so far, updated
+ *	move	- best move so far, updated
+ */
+void
+bt_best(const ev_batch_t *batch, const bt_move_t *moves, long *best,
+		bt_move_t *move) {
+	ev_feat_t feat[EV_BATCH];
+	long score;
+
+	assert(batch != NULL && moves != NULL && best != NULL && move != NULL);
+	ev_eval(batch, feat);
+	for (int b = 0; b < batch->n; b++) {
+		score = 0;
+		for (int x = 0; x < batch->w; x++) {
+			score += feat[b].height[x];
+		}
+		score = score * BT_HEIGHT + (long) feat[b].holes * BT_HOLES
+			+ (long) feat[b].bump * BT_BUMP + (long) feat[b].full * BT_FULL;
+		if (score < *best) {
+			*best = score;
+			*move = moves[b];
+		}
+	}
+}
+
+/*
+ *	Turn a move into the keys that make it, each pressed and released at
+ *	the given game time.  Returns the number of keys, at most BT_MAXKEYS.
+ *	time	- game time, in parts of a tick
+ *	evs		- set to the keys
+ */
+int
+bt_keys(const bt_move_t *move, Uint64 time, g_event_t *evs) {
+	int n = 0;		// Number of keys
+
+	assert(move != NULL && evs != NULL);
+	assert(move->rots < P_ROTS && abs(move->dx) <= BD_MAXW);
+	for (int i = 0; i < move->rots; i++) {
+		bt_press(evs, &n, G_ROT, time);
+	}
+	for (int i = 0; i < abs(move->dx); i++) {
+		bt_press(evs, &n, (move->dx < 0) ? G_LEFT : G_RIGHT, time);
+	}
+	evs[n].time = time;
+	evs[n].key = G_HARD;
+	evs[n].down = true;
+	return n + 1;
+}
+
+/*
+ *	Add a key pressed then released to the keys.
+ *	n	- number of keys, updated
+ */
+void
+bt_press(g_event_t *evs, int *n, g_key_t key, Uint64 time) {
+	assert(evs != NULL && n != NULL);
+	for (int i = 0; i < 2; i++) {
+		evs[*n].time = time;
+		evs[*n].key = key;
+		evs[*n].down = (i == 0);
+		(*n)++;
+	}
+}
@@ -0,0 +1,26 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <stdbool.h>, <SDL/SDL.h>, "bloc.h", "board.h", "piece.h",
+ *	"game.h"
+ *
+ *	Definitions for the built in bot.
+ */
+
+#ifndef BOT_H
+#define BOT_H
+
+// Most keys needed for one move, pressed and released
+#define BT_MAXKEYS	(2 * (P_ROTS - 1 + BD_MAXW) + 1)
+
+// Move for the piece, turned then moved sideways then hard dropped
+typedef struct {
+	int		rots;		// Number of clockwise turns
+	int		dx;			// Blocks moved right, less than 0 for left
+} bt_move_t;
+
+// Function prototypes
+extern void bt_plan(const bloc_game_t *game, bt_move_t *move);
+extern int bt_keys(const bt_move_t *move, Uint64 time, g_event_t *evs);
+
+#endif // BOT_H
@@ -0,0 +1,121 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Code for the high resolution clock and the scheduler.  Sleeping is only 
+ *	as accurate as the system's timer, which can be several milliseconds 
+ *	late, so the scheduler sleeps through most of a wait and spins for the 
+ *	last part of it.  Timeouts that needn't be met exactly only sleep.  How 
+ *	late each wait wakes up is measured, waits can be made from any thread.
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE	199309L
+#endif
+
+#include <assert.h>
+#include <stdbool.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "SDL.h"
+#include "bloc.h"
+#include "clock.h"
+
+static Uint64		ck_spin		= 0;	// Time to spin before waking, in ns
+static ck_jitter_t	ck_jitter;			// How late waits have woken
+
+/*
+ *	Returns the time, in ns, from a clock that never goes backwards.  Only 
+ *	the difference between two times means anything.
+ */
+Uint64
+ck_now(void) {
+#ifdef _WIN32
+	static LARGE_INTEGER freq;		// Counts per second
+	LARGE_INTEGER count;
+
+	if (freq.QuadPart == 0) {
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&count);
+	return (Uint64) (count.QuadPart / freq.QuadPart) * CK_SEC 
+		+ (Uint64) (count.QuadPart % freq.QuadPart) * CK_SEC 
+		/ (Uint64) freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (Uint64) ts.tv_sec * CK_SEC + (Uint64) ts.tv_nsec;
+#endif
+}
+
+/*
+ *	Set how long to spin at the end of every wait, in ns.  0 only sleeps.
+ */
+void
+ck_setspin(Uint64 spin) {
+	assert(spin <= CK_MAXSPIN);
+	ck_spin = spin;
+}
+
+/*
+ *	Wait till the given time, in ns.  Sleeps till the spin time before it 
+ *	then checks the clock till it is reached.  With no spin time it only 
+ *	sleeps, rounded up to the system's milliseconds.  Returns straight away, 
+ *	without counting the wait, if the time has already passed.
+ */
+void
+ck_wait(Uint64 until) {
+	Uint64 now;
+	Uint64 late;	// Time woken after until
+
+	now = ck_now();
+	if (now >= until) {
+		return;
+	}
+	if (ck_spin == 0) {
+		SDL_Delay((Uint32) ((until - now + CK_MS - 1) / CK_MS));
+		now = ck_now();
+	} else {
+		if (until - now > ck_spin) {
+			SDL_Delay((Uint32) ((until - now - ck_spin) / CK_MS));
+		}
+		do {
+			now = ck_now();
+		} while (now < until);
+	}
+	late = (now > until) ? now - until : 0;
+	B_ADD(&ck_jitter.waits, 1);
+	B_ADD(&ck_jitter.total, late);
+	if (late > B_LOAD(&ck_jitter.max)) {
+		// Another thread may race this, at worst a later wake up is missed
+		B_STORE(&ck_jitter.max, late);
+	}
+}
+
+/*
+ *	Sleep till about the given time, in ns, without spinning, for timeouts 
+ *	that needn't be met exactly such as reading keys again.  It isn't 
+ *	counted as a wait, as it may wake a few milliseconds late.
+ */
+void
+ck_sleep(Uint64 until) {
+	Uint64 now;
+
+	now = ck_now();
+	if (now < until) {
+		SDL_Delay((Uint32) ((until - now + CK_MS - 1) / CK_MS));
+	}
+}
+
+/*
+ *	Get how late the waits so far have woken up.
+ */
+void
+ck_getjitter(ck_jitter_t *jitter) {
+	assert(jitter != NULL);
+	jitter->waits = B_LOAD(&ck_jitter.waits);
+	jitter->total = B_LOAD(&ck_jitter.total);
+	jitter->max = B_LOAD(&ck_jitter.max);
+}
@@ -0,0 +1,32 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <SDL/SDL.h>
+ *
+ *	Definitions for the high resolution clock and the scheduler every loop 
+ *	waits with.
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#define CK_US		1000ULL			// Clock units, in ns
+#define CK_MS		1000000ULL
+#define CK_SEC		1000000000ULL
+#define CK_MAXSPIN	(20 * CK_MS)	// Longest spin before a wake up
+
+// How late ck_wait has woken up, all times in ns
+typedef struct {
+	Uint64	waits;		// Number of waits
+	Uint64	total;		// Time late added together
+	Uint64	max;		// Latest wake up
+} ck_jitter_t;
+
+// Function prototypes
+extern Uint64 ck_now(void);
+extern void ck_setspin(Uint64 spin);
+extern void ck_wait(Uint64 until);
+extern void ck_sleep(Uint64 until);
+extern void ck_getjitter(ck_jitter_t *jitter);
+
+#endif // CLOCK_H
@@ -0,0 +1,235 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Code for evaluating batches of boards.  The features of several boards 
+ *	are found at once, one board in each lane of a SIMD register.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+#include "bloc.h"
+#include "board.h"
+#include "piece.h"
+#include "rng.h"
+#include "score.h"
+#include "game.h"
+#include "eval.h"
+
+#define EV_MAXBITS	10		// Bits needed to count to BD_MAXH
+#define EV_HEIGHT	0		// Counters kept for each column
+#define EV_HOLES	1
+#define EV_WELLS	2
+#define EV_TRANS	3
+#define EV_COUNTERS	4
+
+/*
+ *	Operations on vectors of 64 bit lanes.  AVX2 is used if the compiler 
+ *	targets it, then SSE2, otherwise a vector is a single word.  Define 
+ *	EV_NOSIMD to always use single words.
+ */
+#if defined(__AVX2__) && !defined(EV_NOSIMD)
+#include <immintrin.h>
+#define EV_LANES		4
+typedef __m256i ev_vec_t;
+#define EV_LOAD(p)		_mm256_loadu_si256((const __m256i *) (p))
+#define EV_STORE(p, a)	_mm256_storeu_si256((__m256i *) (p), (a))
+#define EV_SET(x)		_mm256_set1_epi64x((long long) (x))
+#define EV_AND(a, b)	_mm256_and_si256((a), (b))
+#define EV_ANDNOT(a, b)	_mm256_andnot_si256((a), (b))
+#define EV_OR(a, b)		_mm256_or_si256((a), (b))
+#define EV_XOR(a, b)	_mm256_xor_si256((a), (b))
+#define EV_SHL1(a)		_mm256_slli_epi64((a), 1)
+#define EV_SHR1(a)		_mm256_srli_epi64((a), 1)
+#define EV_SUB(a, b)	_mm256_sub_epi64((a), (b))
+#define EV_EQ(a, b)		_mm256_cmpeq_epi64((a), (b))
+#elif defined(__SSE2__) && !defined(EV_NOSIMD)
+#include <emmintrin.h>
+#define EV_LANES		2
+typedef __m128i ev_vec_t;
+#define EV_LOAD(p)		_mm_loadu_si128((const __m128i *) (p))
+#define EV_STORE(p, a)	_mm_storeu_si128((__m128i *) (p), (a))
+#define EV_SET(x)		_mm_set1_epi64x((long long) (x))
+#define EV_AND(a, b)	_mm_and_si128((a), (b))
+#define EV_ANDNOT(a, b)	_mm_andnot_si128((a), (b))
+#define EV_OR(a, b)		_mm_or_si128((a), (b))
+#define EV_XOR(a, b)	_mm_xor_si128((a), (b))
+#define EV_SHL1(a)		_mm_slli_epi64((a), 1)
+#define EV_SHR1(a)		_mm_srli_epi64((a), 1)
+#define EV_SUB(a, b)	_mm_sub_epi64((a), (b))
+// SSE2 can only compare 32 bit lanes, both halves must be equal
+#define EV_EQ(a, b)		_mm_and_si128(_mm_cmpeq_epi32((a), (b)), \
+							_mm_shuffle_epi32(_mm_cmpeq_epi32((a), (b)), 0xB1))
+#else
+#define EV_LANES		1
+typedef Uint64 ev_vec_t;
+#define EV_LOAD(p)		(*(p))
+#define EV_STORE(p, a)	(*(p) = (a))
+#define EV_SET(x)		((Uint64) (x))
+#define EV_AND(a, b)	((a) & (b))
+#define EV_ANDNOT(a, b)	(~(a) & (b))
+#define EV_OR(a, b)		((a) | (b))
+#define EV_XOR(a, b)	((a) ^ (b))
+#define EV_SHL1(a)		((a) << 1)
+#define EV_SHR1(a)		((a) >> 1)
+#define EV_SUB(a, b)	((a) - (b))
+#define EV_EQ(a, b)		(((a) == (b)) ? ~(Uint64) 0 : 0)
+#endif
+
+// Function prototypes
+static void ev_lanes(const ev_batch_t *batch, int b, int nbits, 
+		ev_feat_t *feat, int n);
+static unsigned ev_sum(Uint64 planes[][EV_LANES], int nbits, int j);
+
+/*
+ *	Empty the batch, ready for boards of the given size.
+ */
+void
+ev_clear(ev_batch_t *batch, int w, int h) {
+	assert(batch != NULL);
+	assert(w >= BD_MINW && w <= BD_MAXW && h >= BD_MINH && h <= BD_MAXH);
+	batch->w = w;
+	batch->h = h;
+	batch->n = 0;
+	batch->top = h;
+	memset(batch->rows, 0, h * sizeof(batch->rows[0]));
+}
+
+/*
+ *	Add the game's board to the batch.  Only the lines from the top of the 
+ *	highest column down are copied, the batch was cleared above them.  
+ *	Returns where the board's features will be stored.
+ */
+int
+ev_add(ev_batch_t *batch, const bloc_game_t *game) {
+	const bd_board_t *brd;
+	int top;		// Highest line with blocks
+	int b;			// Board in the batch
+
+	assert(batch != NULL && game != NULL);
+	brd = &game->board;
+	assert(batch->n < EV_BATCH && brd->w == batch->w && brd->h == batch->h);
+	b = batch->n++;
+	top = brd->h;
+	for (int x = 0; x < brd->w; x++) {
+		top = MIN(top, brd->h - brd->height[x]);
+	}
+	for (int y = top; y < brd->h; y++) {
+		batch->rows[y][b] = BD_ROW(game, y);
+	}
+	batch->top = MIN(batch->top, top);
+	return b;
+}
+
+/*
+ *	Find the features of every board in the batch.  Lines above the top of 
+ *	the batch are empty so are skipped, they only add row transitions.
+ *	feat	- array of the batch's size for the features
+ */
+void
+ev_eval(const ev_batch_t *batch, ev_feat_t *feat) {
+	int nbits = 0;		// Bits needed to count the lines
+
+	assert(batch != NULL && feat != NULL);
+	while ((1 << nbits) <= batch->h - batch->top) {
+		nbits++;
+	}
+	assert(nbits <= EV_MAXBITS);
+	for (int b = 0; b < batch->n; b += EV_LANES) {
+		ev_lanes(batch, b, nbits, &feat[b], MIN(EV_LANES, batch->n - b));
+	}
+}
+
+/*
+ *	Find the features of the boards in one vector of lanes, working down 
+ *	from the top of the batch a line at a time.  Each feature is counted 
+ *	for every column with a bit-sliced counter, bit i of the count for 
+ *	column x is bit x of plane i, so adding a line's blocks to the counts 
+ *	is a few logic operations for each plane whatever the width.  The 
+ *	counts are only added up once the whole board has been seen.
+ *	b		- first board of the lanes
+ *	nbits	- number of planes in each counter
+ *	feat	- where the first board's features go
+ *	n		- number of lanes holding boards
+ */
+void
+ev_lanes(const ev_batch_t *batch, int b, int nbits, ev_feat_t *feat, int n) {
+	ev_vec_t planes[EV_COUNTERS][EV_MAXBITS];	// Counts for each column
+	ev_vec_t add[EV_COUNTERS];					// Blocks to count
+	ev_vec_t zero, one, full, last;				// Constants
+	ev_vec_t above;								// Columns with blocks above
+	ev_vec_t lines, walls;						// Counts for each board
+	ev_vec_t row, carry;
+	Uint64 counts[EV_COUNTERS][EV_MAXBITS][EV_LANES];
+	Uint64 nlines[EV_LANES], nwalls[EV_LANES];
+	int w = batch->w;
+
+	zero = EV_SET(0);
+	one = EV_SET(1);
+	full = EV_SET((w == 64) ? ~(bd_row_t) 0 : (((bd_row_t) 1) << w) - 1);
+	last = EV_SET(((bd_row_t) 1) << (w - 1));
+	for (int k = 0; k < EV_COUNTERS; k++) {
+		for (int i = 0; i < nbits; i++) {
+			planes[k][i] = zero;
+		}
+	}
+	above = lines = walls = zero;
+	for (int y = batch->top; y < batch->h; y++) {
+		row = EV_LOAD(&batch->rows[y][b]);
+		add[EV_HOLES] = EV_ANDNOT(row, above);
+		above = EV_OR(above, row);
+		add[EV_HEIGHT] = above;
+		add[EV_WELLS] = EV_ANDNOT(above, EV_AND(EV_OR(EV_SHL1(row), one), 
+				EV_AND(EV_OR(EV_SHR1(row), last), full)));
+		add[EV_TRANS] = EV_AND(EV_XOR(row, EV_OR(EV_SHL1(row), one)), full);
+		lines = EV_SUB(lines, EV_EQ(row, full));
+		walls = EV_SUB(walls, EV_EQ(EV_AND(row, last), zero));
+		for (int i = 0; i < nbits; i++) {
+			for (int k = 0; k < EV_COUNTERS; k++) {
+				carry = EV_AND(planes[k][i], add[k]);
+				planes[k][i] = EV_XOR(planes[k][i], add[k]);
+				add[k] = carry;
+			}
+		}
+	}
+	for (int k = 0; k < EV_COUNTERS; k++) {
+		for (int i = 0; i < nbits; i++) {
+			EV_STORE(counts[k][i], planes[k][i]);
+		}
+	}
+	EV_STORE(nlines, lines);
+	EV_STORE(nwalls, walls);
+	for (int j = 0; j < n; j++) {
+		for (int x = 0; x < w; x++) {
+			feat[j].height[x] = 0;
+			for (int i = 0; i < nbits; i++) {
+				feat[j].height[x] |= ((counts[EV_HEIGHT][i][j] >> x) & 1) << i;
+			}
+		}
+		feat[j].bump = 0;
+		for (int x = 1; x < w; x++) {
+			feat[j].bump += abs(feat[j].height[x] - feat[j].height[x - 1]);
+		}
+		feat[j].holes = ev_sum(counts[EV_HOLES], nbits, j);
+		feat[j].wells = ev_sum(counts[EV_WELLS], nbits, j);
+		feat[j].trans = ev_sum(counts[EV_TRANS], nbits, j) 
+				+ (unsigned) nwalls[j] + 2 * batch->top;
+		feat[j].full = (unsigned) nlines[j];
+	}
+}
+
+/*
+ *	Returns the total of the counts for every column of lane j of a 
+ *	bit-sliced counter.
+ */
+unsigned
+ev_sum(Uint64 planes[][EV_LANES], int nbits, int j) {
+	unsigned sum = 0;
+
+	for (int i = 0; i < nbits; i++) {
+		sum += (unsigned) bd_count(planes[i][j]) << i;
+	}
+	return sum;
+}
@@ -0,0 +1,49 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <stdbool.h>, <SDL/SDL.h>, "bloc.h", "board.h"
+ *
+ *	Definitions for evaluating batches of boards.
+ */
+
+#ifndef EVAL_H
+#define EVAL_H
+
+#define EV_BATCH	16		// Most boards in a batch, a multiple of 4
+
+/*
+ *	A batch of boards of the same size.  The boards are interleaved, line y 
+ *	of every board is stored next to each other, so one load fetches the 
+ *	same line of as many boards as the SIMD registers hold.  Lines are in 
+ *	board order, counting down from the top, with one bit per block as in 
+ *	the game board.  No board has any blocks above line top.
+ */
+typedef struct {
+	int			w;							// Board size, in blocks
+	int			h;
+	int			n;							// Number of boards
+	int			top;						// Highest line with blocks
+	bd_row_t	rows[BD_MAXH][EV_BATCH];	// Line y of board b
+} ev_batch_t;
+
+/*
+ *	Features of a board.  Walls count as filled, so every empty line has 
+ *	two row transitions.  A well block is an empty block with filled blocks 
+ *	or walls either side and nothing above it.
+ */
+typedef struct {
+	Uint16		height[BD_MAXW];	// Height of each column
+	unsigned	holes;				// Empty blocks with a block above them
+	unsigned	bump;				// Height differences of next columns
+	unsigned	trans;				// Changes between empty and filled blocks 
+									// along the rows
+	unsigned	wells;				// Depths of the wells added together
+	unsigned	full;				// Full lines
+} ev_feat_t;
+
+// Function prototypes
+extern void ev_clear(ev_batch_t *batch, int w, int h);
+extern int ev_add(ev_batch_t *batch, const bloc_game_t *game);
+extern void ev_eval(const ev_batch_t *batch, ev_feat_t *feat);
+
+#endif // EVAL_H
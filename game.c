@@ -0,0 +1,183 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Code for saving and restoring the state of a whole game, the game's 
+ *	timing and the player's keys.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include "SDL.h"
+#include "bloc.h"
+#include "board.h"
+#include "piece.h"
+#include "rng.h"
+#include "score.h"
+#include "game.h"
+
+#define G_DASMS		167		// Time a sideways key is held till it repeats
+#define G_ARRMS		33		// Time between repeats, in ms
+
+// Parts of a tick in the given time, in ms
+#define G_PARTS(game, ms)	((Uint64) (ms) * (game)->rate)
+
+// Function prototypes
+static void g_packpiece(const piece_t *piece, g_piece_t *snap);
+static void g_unpackpiece(const g_piece_t *snap, piece_t *piece);
+
+/*
+ *	Save the game to a snapshot.  Returns false, leaving the snapshot 
+ *	unchanged, if the board is too big for a snapshot.
+ */
+bool
+g_snapshot(const bloc_game_t *game, g_snap_t *snap) {
+	assert(game != NULL && snap != NULL);
+	if (!bd_snapshot(game, &snap->board)) {
+		return false;
+	}
+	snap->score = game->score;
+	snap->lines = game->lines;
+	snap->pieces = game->pieces;
+	snap->hash = game->hash;
+	snap->rng = game->rng;
+	snap->bag = game->bag;
+	snap->rate = game->rate;
+	snap->time = game->time;
+	snap->move = game->move;
+	snap->grav = game->grav;
+	g_packpiece(&game->piece, &snap->piece);
+	g_packpiece(&game->nextpiece, &snap->nextpiece);
+	return true;
+}
+
+/*
+ *	Restore the game from a snapshot.  The shapes must be the same as when 
+ *	the snapshot was taken.
+ */
+void
+g_restore(bloc_game_t *game, const g_snap_t *snap) {
+	assert(game != NULL && snap != NULL);
+	bd_restore(game, &snap->board);
+	game->score = (score_t) snap->score;
+	game->lines = snap->lines;
+	game->pieces = snap->pieces;
+	game->hash = snap->hash;
+	game->rng = snap->rng;
+	game->bag = snap->bag;
+	game->rate = snap->rate;
+	game->time = snap->time;
+	game->move = snap->move;
+	game->grav = snap->grav;
+	g_unpackpiece(&snap->piece, &game->piece);
+	g_unpackpiece(&snap->nextpiece, &game->nextpiece);
+}
+
+/*
+ *	Pack a piece for a snapshot.  The piece must be on, or next to, a board 
+ *	small enough for a snapshot.
+ */
+void
+g_packpiece(const piece_t *piece, g_piece_t *snap) {
+	assert(piece != NULL && snap != NULL);
+	assert(piece->x >= -128 && piece->x < 128);
+	assert(piece->y >= -128 && piece->y < 128);
+	snap->shape = (Uint8) piece->shape;
+	snap->col = (Uint8) piece->col;
+	snap->rot = (Uint8) piece->rot;
+	snap->x = (Sint8) piece->x;
+	snap->y = (Sint8) piece->y;
+}
+
+/*
+ *	Unpack a piece from a snapshot.
+ */
+void
+g_unpackpiece(const g_piece_t *snap, piece_t *piece) {
+	assert(snap != NULL && piece != NULL);
+	piece->shape = snap->shape;
+	piece->col = (bd_col_t) snap->col;
+	piece->rot = (p_rot_t) snap->rot;
+	piece->x = snap->x;
+	piece->y = snap->y;
+}
+
+/*
+ *	Returns the number of game ticks nearest to the given time, at least one.
+ *	ms	- time, in milliseconds
+ */
+unsigned
+g_ticks(const bloc_game_t *game, unsigned ms) {
+	unsigned long ticks;
+
+	assert(game != NULL);
+	ticks = ((unsigned long) ms * game->rate + 500) / 1000;
+	return (ticks > 0) ? (unsigned) ticks : 1;
+}
+
+/*
+ *	Apply a key pressed or released at the event's time.  A sideways key 
+ *	moves the piece straight away, then again every G_ARRMS once it has been 
+ *	held for G_DASMS, see g_repeat.  The times are counted from the event 
+ *	rather than the tick it is applied in.  Soft drop lasts while its key 
+ *	is held.
+ *	gameover	- set to true if the game is over after a hard drop
+ */
+void
+g_key(bloc_game_t *game, const g_event_t *ev, bool *gameover) {
+	b_move_t *move;		// Game piece's movement
+	int vel;			// Direction of a sideways key
+	unsigned lines;		// Number of full lines
+	unsigned dist;		// Distance of hard drop
+
+	assert(game != NULL && ev != NULL && gameover != NULL);
+	move = &game->move;
+	switch (ev->key) {
+		case G_LEFT:
+		case G_RIGHT:
+			vel = (ev->key == G_LEFT) ? -1 : 1;
+			if (ev->down) {
+				move->xvel = vel;
+				p_movex(game, vel);
+				move->xtime = ev->time + G_PARTS(game, G_DASMS);
+			} else if (move->xvel == vel) {
+				move->xvel = 0;
+			}
+			break;
+		case G_ROT:
+			if (ev->down) {
+				p_rot(game, 1);
+			}
+			break;
+		case G_SOFT:
+			move->yticks = (ev->down) ? g_ticks(game, G_SOFTMS) : 0;
+			break;
+		case G_HARD:
+			if (ev->down) {
+				lines = p_harddrop(game, gameover, &dist);
+				if (lines > 0) {
+					s_award(game, lines, G_LEV(game->grav.diff), dist, 
+							game->board.h);
+				}
+			}
+			break;
+		default:
+			// VOID
+			break;
+	}
+}
+
+/*
+ *	Move the piece sideways for every repeat of the held key due by the 
+ *	given game time.
+ */
+void
+g_repeat(bloc_game_t *game, Uint64 time) {
+	b_move_t *move;		// Game piece's movement
+
+	assert(game != NULL);
+	move = &game->move;
+	while (move->xvel != 0 && move->xtime <= time) {
+		p_movex(game, move->xvel);
+		move->xtime += G_PARTS(game, G_ARRMS);
+	}
+}
@@ -0,0 +1,109 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <stdbool.h>, <SDL/SDL.h>, "bloc.h", "board.h", "piece.h", 
+ *	"rng.h", "score.h"
+ *
+ *	Definitions for the state of a single game.
+ */
+
+#ifndef GAME_H
+#define GAME_H
+
+#define G_TICKPART	1000	// Parts of a tick game time is kept in
+#define G_SOFTMS	100		// Time between soft drop movements, in ms
+#define G_GRAVTICKS	30		// Difficulty gravity starts at
+
+// Current level, based on current difficulty
+#define G_LEV(x)	(1 + G_GRAVTICKS - (x))
+
+// Keys the player controls the game with
+typedef enum { G_LEFT = 0, G_RIGHT, G_ROT, G_SOFT, G_HARD } g_key_t;
+
+// A key pressed or released, at a game time in parts of a tick
+typedef struct {
+	Uint64		time;
+	g_key_t		key;
+	bool		down;
+} g_event_t;
+
+// Game piece's movement
+typedef struct {
+	int			xvel;	// x velocity
+	Uint64		xtime;	// Game time of next x movement
+	unsigned	yticks;	// Number of ticks till next y movement (soft drop)
+} b_move_t;
+
+// Game piece's gravity
+typedef struct {
+	unsigned	diff;		// Current difficulty
+	Uint32		speed;		// Cells fallen per tick, in 16.16 fixed point
+	Uint32		fall;		// Part of a cell fallen so far, in 16.16
+	unsigned	diffticks;	// Number of game ticks till next difficulty
+} b_grav_t;
+
+/*
+ *	Everything that makes up one game in progress.  The board, piece and 
+ *	score functions all take the game they work on, there is no file-scope 
+ *	game state, so any number of games can be run side by side.
+ *
+ *	hash is a Zobrist hash of the lines on the board, one key for each line 
+ *	made from its blocks, and the shapes of the current and next pieces, 
+ *	kept up to date as blocks are added, lines removed and pieces spawned.  
+ *	Where the current piece is and the colours of the blocks aren't part of 
+ *	it, so it identifies the position a piece is placed from.
+ */
+struct bloc_game {
+	bd_board_t	board;		// Game board
+	piece_t		piece;		// The main game piece
+	piece_t		nextpiece;	// The next game piece
+	score_t		score;		// The score for this game
+	unsigned	lines;		// Lines cleared
+	unsigned	pieces;		// Pieces that have come on to the board
+	b_move_t	move;		// Game piece's movement
+	b_grav_t	grav;		// Game piece's gravity
+	Uint64		hash;		// Hash of the board and pieces
+	rng_t		rng;		// Generator for the pieces
+	Uint64		bag;		// Shapes left in the bag, one bit each
+	unsigned	rate;		// Game ticks per second
+	Uint64		time;		// Time of the last tick, in parts of a tick
+};
+
+// A piece in a snapshot
+typedef struct {
+	Uint8	shape;		// Shape, from the set of shapes loaded
+	Uint8	col;		// Colour
+	Uint8	rot;		// Rotation
+	Sint8	x;			// Position, in blocks
+	Sint8	y;
+} g_piece_t;
+
+/*
+ *	Snapshot of a game in progress.  It is plain data of a fixed size, so it 
+ *	can be copied with memcpy or assignment and saved as it is.  Only games 
+ *	on boards up to BD_SNAPCELLS blocks and BD_SNAPH lines fit.
+ */
+typedef struct {
+	bd_snap_t	board;		// Game board
+	Uint64		score;		// The score for this game
+	Uint32		lines;		// Lines cleared
+	Uint32		pieces;		// Pieces that have come on to the board
+	Uint64		hash;		// Hash of the board and pieces
+	rng_t		rng;		// Generator for the pieces
+	Uint64		bag;		// Shapes left in the bag
+	Uint32		rate;		// Game ticks per second
+	Uint64		time;		// Time of the last tick
+	b_move_t	move;		// Game piece's movement
+	b_grav_t	grav;		// Game piece's gravity
+	g_piece_t	piece;		// The main game piece
+	g_piece_t	nextpiece;	// The next game piece
+} g_snap_t;
+
+// Function prototypes
+extern bool g_snapshot(const bloc_game_t *game, g_snap_t *snap);
+extern void g_restore(bloc_game_t *game, const g_snap_t *snap);
+extern unsigned g_ticks(const bloc_game_t *game, unsigned ms);
+extern void g_key(bloc_game_t *game, const g_event_t *ev, bool *gameover);
+extern void g_repeat(bloc_game_t *game, Uint64 time);
+
+#endif // GAME_H
@@ -13,7 +13,6 @@
 
 #define M_NUMMAIN	4			// Number of menu items in the main menu
 #define M_ITEMSPC	24			// Amount of space between items in menu
-#define M_TICKLEN	20			// Menu tick length in miliseconds
 #define M_MAINX		100			// Main menu offset from game area origin
 #define M_MAINY		204
 #define M_CURSW		24			// Cursor dimensions
@@ -26,13 +25,10 @@
 
 // Menu item
 typedef struct {
-	bool (*fp)(void);	// Function pointer
+	b_sceneid_t next;	// Scene to go to when chosen
 	const char *s;		// Menu string
 } m_item_t;
 
-// Main menu function prototypes
-static bool m_exit(void);
-
 // Main menu
 static struct {
 	unsigned	cur;				// Currently selected item
@@ -40,92 +36,73 @@ static struct {
 } m_main = {
 	0,
 	{
-		{ b_newgame,	"New game" },
-		{ b_intro,		"Instructions" },
-		{ b_scores,		"High scores" },
-		{ m_exit,		"Exit" }
+		{ B_GAME,		"New game" },
+		{ B_INTRO,		"Instructions" },
+		{ B_SCORES,		"High scores" },
+		{ B_EXIT,		"Exit" }
 	}
 };
 
 // Function prototypes
-static bool m_keys(void);
 static void m_print(SDL_Surface *screen, SDL_Surface *font, int x, int y);
 static void m_cursor(SDL_Surface *screen, SDL_Surface *blocks, int x, int y);
 
 /*
- *	Display the main menu and handle user input.
+ *	Draw the main menu.
  *	screen	- screen surface
  *	bg		- menu background
  *	font	- font bitmap
  *	blocks	- blocks bitmap, used for cursor
  */
 void
-m_display(SDL_Surface *screen, SDL_Surface *bg, SDL_Surface *font, 
+m_draw(SDL_Surface *screen, SDL_Surface *bg, SDL_Surface *font, 
 		SDL_Surface *blocks, int x, int y) {
-	bool 	quit 		= false;	// Set to true if exiting the game
-	Uint32	nexttick;				// Time, in ms, of next menu tick
-
 	assert(screen != NULL && bg != NULL && font != NULL && blocks != NULL);
-	nexttick = SDL_GetTicks() + M_TICKLEN;
-	do {
-		b_drawbg(screen, bg);
-		m_print(screen, font, x + M_MAINX, y + M_MAINY);
-		m_cursor(screen, blocks, x + M_CURSX, y + M_CURSY);
-		b_update(screen);
-		quit = m_keys();
-		SDL_Delay(b_delaylen(nexttick));
-		nexttick += M_TICKLEN;
-	} while (!quit);
+	b_drawbg(screen, bg);
+	m_print(screen, font, x + M_MAINX, y + M_MAINY);
+	m_cursor(screen, blocks, x + M_CURSX, y + M_CURSY);
+	b_update(screen);
 }
 
 /*
- *	Process keys and user quit for menu.  User can choose a menu by using the 
- *	up and down arrow keys.  A menu is selected by pressing return, escape 
- *	quits the game.
+ *	Handle a key for the menu.  User can choose a menu by using the up and 
+ *	down arrow keys.  A menu is selected by pressing return, escape quits the 
+ *	game.  Returns the scene to go to, B_STAY to stay on the menu.
  */
-bool
-m_keys(void) {
-	SDL_Event	event;
-	bool		exit		= false;	// Exit the game
+b_sceneid_t
+m_key(const SDL_Event *event) {
+	b_sceneid_t next = B_STAY;	// Scene to go to
 
-	while (SDL_PollEvent(&event)) {
-		switch (event.type) {
-			case SDL_KEYDOWN:
-				switch (event.key.keysym.sym) {
-					case SDLK_ESCAPE:
-						exit = true;
-						break;
-					case SDLK_UP:
-						if (m_main.cur == 0) {
-							m_main.cur = M_NUMMAIN - 1;
-						} else {
-							m_main.cur--;
-						}
-						break;
-					case SDLK_DOWN:
-						if (m_main.cur >= M_NUMMAIN - 1) {
-							m_main.cur = 0;
-						} else {
-							m_main.cur++;
-						}
-						break;
-					case SDLK_RETURN:
-						exit = (*m_main.items[m_main.cur].fp)();
-						break;
-					default:
-						// VOID
-						break;
-				}
-				break;
-			case SDL_QUIT:
-				exit = true;
-				break;
-			default:
-				// VOID
-				break;
-		}
+	assert(event != NULL);
+	if (event->type != SDL_KEYDOWN) {
+		return B_STAY;
 	}
-	return exit;
+	switch (event->key.keysym.sym) {
+		case SDLK_ESCAPE:
+			next = B_EXIT;
+			break;
+		case SDLK_UP:
+			if (m_main.cur == 0) {
+				m_main.cur = M_NUMMAIN - 1;
+			} else {
+				m_main.cur--;
+			}
+			break;
+		case SDLK_DOWN:
+			if (m_main.cur >= M_NUMMAIN - 1) {
+				m_main.cur = 0;
+			} else {
+				m_main.cur++;
+			}
+			break;
+		case SDLK_RETURN:
+			next = m_main.items[m_main.cur].next;
+			break;
+		default:
+			// VOID
+			break;
+	}
+	return next;
 }
 
 /*
@@ -167,11 +144,3 @@ m_cursor(SDL_Surface *screen, SDL_Surface *blocks, int x, int y) {
 		b_error("Error blitting cursor: %s\n", SDL_GetError());
 	}
 }
-
-/*
- *	Exit game.
- */
-bool
-m_exit(void) {
-	return true;
-}
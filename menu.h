@@ -1,7 +1,7 @@
 /*
  *	See LICENSE.txt file for copyright and license details.
  *
- *	Requires: <SDL/SDL.h>
+ *	Requires: <SDL/SDL.h>, "bloc.h"
  *
  *	Definitions for the in-game menu.
  */
@@ -10,7 +10,8 @@
 #define MENU_H
 
 // Function prototypes
-extern void m_display(SDL_Surface *screen, SDL_Surface *bg, SDL_Surface *font, 
+extern void m_draw(SDL_Surface *screen, SDL_Surface *bg, SDL_Surface *font, 
 		SDL_Surface *blocks, int x, int y);
+extern b_sceneid_t m_key(const SDL_Event *event);
 
 #endif // MENU_H
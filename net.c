@@ -0,0 +1,455 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Code for the link between the two players of a versus game, over a TCP
+ *	socket or, for an address with a / in, a UNIX socket.  The player who
+ *	hosts sends the settings the game starts with as a line of text:
+ *
+ *	bloc seed width height rate gravity bag shapes
+ *
+ *	the same as a game in a replay file.  From then on each player sends a
+ *	frame for every tick, 4 bytes of tick then 2 of keys, both most
+ *	significant byte first, then 2 bytes of 0.  Only POSIX sockets are
+ *	supported.
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE	200112L
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include "SDL.h"
+#include "bloc.h"
+#include "board.h"
+#include "clock.h"
+#include "piece.h"
+#include "rng.h"
+#include "score.h"
+#include "game.h"
+#include "replay.h"
+#include "net.h"
+
+#define NT_HELLO		"bloc"				// First word of the settings
+#define NT_MAXSTR		(RP_MAXNAME + 128)	// Longest settings line
+#define NT_NOSHAPES		"-"					// Shapes name for Tetriminos
+#define NT_LOCALHOST	"127.0.0.1"			// Address with only a port
+
+#ifndef _WIN32
+// Function prototypes
+static int nt_open(const char *addr, bool host);
+static int nt_openunix(const char *path, bool host);
+static int nt_opentcp(const char *addr, bool host);
+static void nt_start(nt_link_t *link, int fd, unsigned lag);
+static void nt_put(Uint8 *buf, const nt_frame_t *frame);
+static void nt_get(const Uint8 *buf, nt_frame_t *frame);
+static bool nt_isagain(void);
+
+/*
+ *	Wait for the other player to join at the address, then send them the
+ *	settings the game starts with.  Exits if the link can't be made.
+ *	addr	- [host:]port, or path of a UNIX socket
+ *	lag		- latency to add to frames sent, in ms
+ */
+void
+nt_host(nt_link_t *link, const char *addr, unsigned lag,
+		const rp_setup_t *setup) {
+	char s[NT_MAXSTR];		// Settings line
+	int len;				// Length of settings line
+	int fd;					// Socket
+
+	assert(link != NULL && addr != NULL && setup != NULL);
+	printf("Waiting for the other player on %s\n", addr);
+	fflush(stdout);
+	fd = nt_open(addr, true);
+	len = snprintf(s, NT_MAXSTR, NT_HELLO " %llu %d %d %u %.17g %d %s\n",
+			(unsigned long long) setup->seed, setup->w, setup->h, setup->rate,
+			setup->gravity, setup->bag,
+			(setup->shapes[0] == '\0') ? NT_NOSHAPES : setup->shapes);
+	if (len < 0 || len >= NT_MAXSTR) {
+		b_error("Error: game settings too long to send\n");
+	}
+	for (int n = 0, sent = 0; sent < len; sent += n) {
+		n = (int) write(fd, s + sent, (size_t) (len - sent));
+		if (n <= 0) {
+			b_error("Error sending game settings: %s\n", strerror(errno));
+		}
+	}
+	nt_start(link, fd, lag);
+}
+
+/*
+ *	Join the player hosting at the address and get the settings the game
+ *	starts with from them.  Exits if the link can't be made.
+ *	addr	- [host:]port, or path of a UNIX socket
+ *	lag		- latency to add to frames sent, in ms
+ */
+void
+nt_join(nt_link_t *link, const char *addr, unsigned lag, rp_setup_t *setup) {
+	char s[NT_MAXSTR];			// Settings line
+	unsigned long long seed;
+	int bag;
+	int n;						// Length of what was read
+	int fd;						// Socket
+
+	assert(link != NULL && addr != NULL && setup != NULL);
+	fd = nt_open(addr, false);
+	for (n = 0; n == 0 || s[n-1] != '\n'; n++) {
+		if (n == NT_MAXSTR - 1 || read(fd, &s[n], 1) != 1) {
+			b_error("Error getting game settings from %s\n", addr);
+		}
+	}
+	s[n] = '\0';
+	if (sscanf(s, NT_HELLO " %llu %d %d %u %lf %d %n", &seed, &setup->w,
+			&setup->h, &setup->rate, &setup->gravity, &bag, &n) < 6
+	||  setup->w < BD_MINW || setup->w > BD_MAXW
+	||  setup->h < BD_MINH || setup->h > BD_MAXH || setup->rate == 0) {
+		b_error("Error: %s is not a bloc player\n", addr);
+	}
+	setup->seed = seed;
+	setup->bag = (bag != 0);
+	s[strcspn(s, "\r\n")] = '\0';
+	if (strcmp(s + n, NT_NOSHAPES) == 0) {
+		setup->shapes[0] = '\0';
+	} else {
+		strncpy(setup->shapes, s + n, RP_MAXNAME - 1);
+		setup->shapes[RP_MAXNAME-1] = '\0';
+	}
+	nt_start(link, fd, lag);
+}
+
+/*
+ *	Open a socket to the address, waiting for the other player to join if
+ *	hosting.  Exits if it can't be opened.
+ */
+int
+nt_open(const char *addr, bool host) {
+	assert(addr != NULL);
+	// A player who has gone shouldn't kill the game when it writes to them
+	signal(SIGPIPE, SIG_IGN);
+	return (strchr(addr, '/') != NULL)
+		? nt_openunix(addr, host) : nt_opentcp(addr, host);
+}
+
+/*
+ *	Open a UNIX socket at the path.  The host removes the path once the
+ *	other player has joined.
+ */
+int
+nt_openunix(const char *path, bool host) {
+	struct sockaddr_un sa;
+	int fd, lfd;			// Socket, listening socket
+
+	assert(path != NULL);
+	if (strlen(path) >= sizeof(sa.sun_path)) {
+		b_error("Error: socket path %s is too long\n", path);
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path, path);
+	fd = lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1) {
+		b_error("Error opening socket: %s\n", strerror(errno));
+	}
+	if (host) {
+		unlink(path);
+		if (bind(lfd, (struct sockaddr *) &sa, sizeof(sa)) == -1
+		||  listen(lfd, 1) == -1 || (fd = accept(lfd, NULL, NULL)) == -1) {
+			b_error("Error hosting on %s: %s\n", path, strerror(errno));
+		}
+		close(lfd);
+		unlink(path);
+	} else if (connect(fd, (struct sockaddr *) &sa, sizeof(sa)) == -1) {
+		b_error("Error joining %s: %s\n", path, strerror(errno));
+	}
+	return fd;
+}
+
+/*
+ *	Open a TCP socket to [host:]port, the local host if only a port is
+ *	given.  Nagle's algorithm is turned off, frames are small and must go
+ *	straight away.
+ */
+int
+nt_opentcp(const char *addr, bool host) {
+	char name[NT_MAXSTR];		// Host name
+	const char *port;
+	struct addrinfo hints, *res, *ai;
+	int fd = -1, lfd;			// Socket, listening socket
+	int on = 1;
+	int err;
+
+	assert(addr != NULL);
+	port = strrchr(addr, ':');
+	if (port == NULL) {
+		strcpy(name, NT_LOCALHOST);
+		port = addr;
+	} else if ((size_t) (port - addr) < sizeof(name)) {
+		memcpy(name, addr, (size_t) (port - addr));
+		name[port-addr] = '\0';
+		port++;
+	} else {
+		b_error("Error: address %s is too long\n", addr);
+	}
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	err = getaddrinfo(name, port, &hints, &res);
+	if (err != 0) {
+		b_error("Error looking up %s: %s\n", addr, gai_strerror(err));
+	}
+	for (ai = res; ai != NULL && fd == -1; ai = ai->ai_next) {
+		fd = lfd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd == -1) {
+			continue;
+		}
+		if (host) {
+			setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+			if (bind(lfd, ai->ai_addr, ai->ai_addrlen) == -1
+			||  listen(lfd, 1) == -1) {
+				fd = -1;
+			} else {
+				fd = accept(lfd, NULL, NULL);
+			}
+			close(lfd);
+		} else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(res);
+	if (fd == -1) {
+		b_error("Error %s %s: %s\n", host ? "hosting on" : "joining", addr,
+				strerror(errno));
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	return fd;
+}
+
+/*
+ *	Start using the socket for frames, without waiting to read or write.
+ *	lag	- latency to add to frames sent, in ms
+ */
+void
+nt_start(nt_link_t *link, int fd, unsigned lag) {
+	int flags;
+
+	assert(link != NULL && lag <= NT_MAXLAG);
+	flags = fcntl(fd, F_GETFL);
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		b_error("Error setting up socket: %s\n", strerror(errno));
+	}
+	link->fd = fd;
+	link->lag = lag * CK_MS;
+	link->head = link->tail = 0;
+	link->wlen = link->rlen = link->rpos = 0;
+	link->closed = false;
+}
+
+/*
+ *	Send a frame once the latency added has gone.  It is only written on
+ *	the next flush after that.  If too many frames are waiting the other
+ *	player isn't reading them and the link is closed.
+ *	now	- time, in ns
+ */
+void
+nt_send(nt_link_t *link, const nt_frame_t *frame, Uint64 now) {
+	unsigned i;		// Where the frame goes
+
+	assert(link != NULL && frame != NULL);
+	if (link->tail - link->head == NT_MAXOUT) {
+		link->closed = true;
+	}
+	if (link->closed) {
+		return;
+	}
+	i = link->tail++ % NT_MAXOUT;
+	link->out[i] = *frame;
+	link->due[i] = now + link->lag;
+}
+
+/*
+ *	Write as many of the frames due by now as the socket takes.  Returns
+ *	true once every frame sent has been written, or the link is closed.
+ *	now	- time, in ns
+ */
+bool
+nt_flush(nt_link_t *link, Uint64 now) {
+	unsigned i;
+	ssize_t n;		// Bytes written
+
+	assert(link != NULL);
+	while (link->head != link->tail && link->due[link->head % NT_MAXOUT] <= now
+	&&     link->wlen + NT_FRAMELEN <= sizeof(link->wbuf)) {
+		i = link->head++ % NT_MAXOUT;
+		nt_put(&link->wbuf[link->wlen], &link->out[i]);
+		link->wlen += NT_FRAMELEN;
+	}
+	if (link->wlen > 0 && !link->closed) {
+		n = write(link->fd, link->wbuf, link->wlen);
+		if (n > 0) {
+			link->wlen -= (unsigned) n;
+			memmove(link->wbuf, link->wbuf + n, link->wlen);
+		} else if (n == -1 && !nt_isagain()) {
+			link->closed = true;
+		}
+	}
+	return link->closed || (link->head == link->tail && link->wlen == 0);
+}
+
+/*
+ *	Get the next frame from the other player.  Returns false if a whole
+ *	frame hasn't arrived yet.  Once the other player has gone, the link is
+ *	marked closed.
+ */
+bool
+nt_recv(nt_link_t *link, nt_frame_t *frame) {
+	ssize_t n;		// Bytes read
+
+	assert(link != NULL && frame != NULL);
+	if (link->rlen - link->rpos < NT_FRAMELEN) {
+		link->rlen -= link->rpos;
+		memmove(link->rbuf, link->rbuf + link->rpos, link->rlen);
+		link->rpos = 0;
+		if (!link->closed) {
+			n = read(link->fd, link->rbuf + link->rlen,
+					sizeof(link->rbuf) - link->rlen);
+			if (n > 0) {
+				link->rlen += (unsigned) n;
+			} else if (n == 0 || !nt_isagain()) {
+				link->closed = true;
+			}
+		}
+		if (link->rlen < NT_FRAMELEN) {
+			return false;
+		}
+	}
+	nt_get(&link->rbuf[link->rpos], frame);
+	link->rpos += NT_FRAMELEN;
+	return true;
+}
+
+/*
+ *	Close the link, if it is open.
+ */
+void
+nt_close(nt_link_t *link) {
+	assert(link != NULL);
+	if (link->fd != -1) {
+		close(link->fd);
+		link->fd = -1;
+	}
+	link->closed = true;
+}
+
+/*
+ *	Put a frame into the bytes it is sent as.
+ */
+void
+nt_put(Uint8 *buf, const nt_frame_t *frame) {
+	assert(buf != NULL && frame != NULL);
+	buf[0] = (Uint8) (frame->tick >> 24);
+	buf[1] = (Uint8) (frame->tick >> 16);
+	buf[2] = (Uint8) (frame->tick >> 8);
+	buf[3] = (Uint8) frame->tick;
+	buf[4] = (Uint8) (frame->keys >> 8);
+	buf[5] = (Uint8) frame->keys;
+	buf[6] = buf[7] = 0;
+}
+
+/*
+ *	Get a frame from the bytes it was sent as.
+ */
+void
+nt_get(const Uint8 *buf, nt_frame_t *frame) {
+	assert(buf != NULL && frame != NULL);
+	frame->tick = (Uint32) buf[0] << 24 | (Uint32) buf[1] << 16
+		| (Uint32) buf[2] << 8 | buf[3];
+	frame->keys = (Uint16) (buf[4] << 8 | buf[5]);
+}
+
+/*
+ *	Returns true if the last read or write failed only because it would
+ *	have had to wait.
+ */
+bool
+nt_isagain(void) {
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+#else
+
+/*
+ *	Versus games need POSIX sockets, exit.
+ */
+void
+nt_host(nt_link_t *link, const char *addr, unsigned lag,
+		const rp_setup_t *setup) {
+	(void) link;
+	(void) addr;
+	(void) lag;
+	(void) setup;
+	b_error("Error: versus games aren't supported on Windows\n");
+}
+
+/*
+ *	Versus games need POSIX sockets, exit.
+ */
+void
+nt_join(nt_link_t *link, const char *addr, unsigned lag, rp_setup_t *setup) {
+	nt_host(link, addr, lag, setup);
+}
+
+/*
+ *	There is never a link to send on.
+ */
+void
+nt_send(nt_link_t *link, const nt_frame_t *frame, Uint64 now) {
+	(void) link;
+	(void) frame;
+	(void) now;
+}
+
+/*
+ *	There is never a link to flush.
+ */
+bool
+nt_flush(nt_link_t *link, Uint64 now) {
+	(void) link;
+	(void) now;
+	return true;
+}
+
+/*
+ *	There is never a link to read from.
+ */
+bool
+nt_recv(nt_link_t *link, nt_frame_t *frame) {
+	(void) link;
+	(void) frame;
+	return false;
+}
+
+/*
+ *	There is never a link to close.
+ */
+void
+nt_close(nt_link_t *link) {
+	(void) link;
+}
+
+#endif // _WIN32
@@ -0,0 +1,55 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <stdbool.h>, <stdio.h>, <SDL/SDL.h>, "bloc.h", "score.h",
+ *	"game.h", "replay.h"
+ *
+ *	Definitions for the link between the two players of a versus game.
+ */
+
+#ifndef NET_H
+#define NET_H
+
+#define NT_MAXLAG	1000	// Most latency that can be added, in ms
+#define NT_MAXOUT	1024	// Frames that can wait to be sent
+#define NT_FRAMELEN	8		// Bytes a frame is sent as
+#define NT_MAXIN	64		// Frames that can be read at once
+
+// Keys a player held and pressed over one tick
+typedef struct {
+	Uint32	tick;		// Tick the keys are for
+	Uint16	keys;		// Keys, see b_vskeys
+} nt_frame_t;
+
+/*
+ *	Link to the other player.  Frames sent are held for the latency added,
+ *	to try out a slow link on a fast one, then written without waiting.
+ *	Whatever can't be written yet is kept for the next flush.  Frames are
+ *	read without waiting, from whatever has arrived.
+ */
+typedef struct {
+	int			fd;							// Socket, -1 if not open
+	Uint64		lag;						// Latency added, in ns
+	nt_frame_t	out[NT_MAXOUT];				// Frames waiting to be sent
+	Uint64		due[NT_MAXOUT];				// Time, in ns, each can be sent
+	unsigned	head;						// Oldest frame waiting
+	unsigned	tail;						// Where the next frame goes
+	Uint8		wbuf[NT_MAXOUT * NT_FRAMELEN];	// Bytes not written yet
+	unsigned	wlen;
+	Uint8		rbuf[NT_MAXIN * NT_FRAMELEN];	// Bytes read, not yet a frame
+	unsigned	rlen;
+	unsigned	rpos;						// First byte not taken as a frame
+	bool		closed;						// Other player has gone
+} nt_link_t;
+
+// Function prototypes
+extern void nt_host(nt_link_t *link, const char *addr, unsigned lag,
+		const rp_setup_t *setup);
+extern void nt_join(nt_link_t *link, const char *addr, unsigned lag,
+		rp_setup_t *setup);
+extern void nt_send(nt_link_t *link, const nt_frame_t *frame, Uint64 now);
+extern bool nt_flush(nt_link_t *link, Uint64 now);
+extern bool nt_recv(nt_link_t *link, nt_frame_t *frame);
+extern void nt_close(nt_link_t *link);
+
+#endif // NET_H
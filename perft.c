@@ -0,0 +1,213 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Code for counting the placements reachable from fixed positions, like 
+ *	perft in chess.  The counts check the move generator and the time taken 
+ *	gives its speed.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "SDL.h"
+#include "bloc.h"
+#include "board.h"
+#include "piece.h"
+#include "rng.h"
+#include "score.h"
+#include "game.h"
+#include "perft.h"
+#include "tt.h"
+
+#define PF_NPOS		5				// Number of positions
+#define PF_BLOCK	'x'				// Block in a position
+#define PF_COL		BLUE			// Colour of the blocks in a position
+#define PF_DEPTHKEY	(1ULL << 32)	// Hash keys for the depth left
+#define PF_LEVEL	1				// Level lines are scored at
+
+// Position to count from
+typedef struct {
+	const char	*name;
+	const char	*rows;		// Lines of the board, at the bottom of the board
+} pf_pos_t;
+
+/*
+ *	Positions to count from, each line is PF_BLOCK for a block and anything 
+ *	else for no block.  The lines are put at the bottom left of the board.
+ */
+static const pf_pos_t pf_positions[PF_NPOS] = {
+	{
+		"empty",
+		""
+	}, {
+		"overhang",
+		"....xxx...\n"
+		"x.......xx\n"
+		"xx.x..x.xx\n"
+		"xxxx.xxxxx\n"
+	}, {
+		"jagged",
+		"x.........\n"
+		"x.x......x\n"
+		"xxx.x..x.x\n"
+		"xxx.xx.xxx\n"
+		"xxxxxx.xxx\n"
+	}, {
+		"lines",
+		"xxxxxxxx..\n"
+		"xxxxxxxx..\n"
+		"xxxxxxxx..\n"
+		"xxxxxxxx..\n"
+	}, {
+		"well",
+		"xxxxxxxxx.\n"
+		"xxxxxxxxx.\n"
+		"xxxxxxxxx.\n"
+		"xxxxxxxxx.\n"
+		"xxxxxxxxx.\n"
+	}
+};
+
+// Counters for a search
+static struct {
+	unsigned long	gens;	// Calls to the move generator
+	unsigned long	hits;	// Positions found in the transposition table
+} pf_stats;
+
+static tt_table_t pf_tt;	// Counts of positions already searched
+
+// Function prototypes
+static void pf_setup(bloc_game_t *game, const pf_pos_t *pos, int w, int h);
+static unsigned long pf_perft(bloc_game_t *game, int depth, int ply);
+static int pf_shape(int ply);
+
+/*
+ *	Count the placements to the given depth from each position and print 
+ *	the counts and how fast they were found.  The pieces come in a fixed 
+ *	order, each shape in turn, so the counts are always the same.
+ *	w, h	- board size, in blocks
+ */
+void
+pf_run(int w, int h, int depth) {
+	static bloc_game_t game;
+	unsigned long nodes;
+	clock_t start;
+	double secs;
+
+	assert(depth > 0 && depth <= PF_MAXDEPTH);
+	for (int i = 0; i < PF_NPOS; i++) {
+		pf_setup(&game, &pf_positions[i], w, h);
+		tt_clear(&pf_tt);
+		pf_stats.gens = 0;
+		pf_stats.hits = 0;
+		start = clock();
+		nodes = pf_perft(&game, depth, 0);
+		secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+		if (secs <= 0) {
+			secs = 1.0 / CLOCKS_PER_SEC;
+		}
+		printf("%-10s depth %d: %lu nodes, %.3f s, %.0f nodes/s, "
+				"%.0f gens/s, %lu hits\n", pf_positions[i].name, depth, nodes, 
+				secs, nodes / secs, pf_stats.gens / secs, pf_stats.hits);
+	}
+}
+
+/*
+ *	Start a game on the position, with the first two pieces of the sequence.
+ */
+void
+pf_setup(bloc_game_t *game, const pf_pos_t *pos, int w, int h) {
+	const char *line, *end;
+	int nlines = 0;
+	int y;
+	bd_row_t row;
+
+	assert(game != NULL && pos != NULL);
+	bd_init(game, w, h);
+	for (line = pos->rows; *line != '\0'; line = strchr(line, '\n') + 1) {
+		nlines++;
+	}
+	if (nlines > h - p_size()) {
+		b_error("Error: board too small for position %s\n", pos->name);
+	}
+	y = h - nlines;
+	for (line = pos->rows; *line != '\0'; line = end + 1, y++) {
+		end = strchr(line, '\n');
+		if (end - line > w) {
+			b_error("Error: board too narrow for position %s\n", pos->name);
+		}
+		row = 0;
+		for (int i = 0; line + i < end; i++) {
+			if (line[i] == PF_BLOCK) {
+				row |= (bd_row_t) 1 << i;
+			}
+		}
+		if (row != 0) {
+			bd_copytobd(game, y, row, PF_COL);
+		}
+	}
+	p_start(game, pf_shape(0), NORTH);
+	p_setnext(game, pf_shape(1), NORTH);
+}
+
+/*
+ *	Returns the number of ways of placing the next depth pieces.  Positions 
+ *	reached by placing pieces in a different order are only searched once, 
+ *	the ply is how many pieces have been placed so far.  Lines cleared are 
+ *	scored, so every clear the pieces make goes through the awards too, up 
+ *	to 5 lines when the pentominoes' I drops into the well from depth 4.
+ */
+unsigned long
+pf_perft(bloc_game_t *game, int depth, int ply) {
+	p_move_t moves[P_MAXMOVES];
+	g_snap_t snap;
+	Uint64 key;					// Position and depth in the table
+	Uint64 count;
+	unsigned long nodes = 0;
+	unsigned lines;				// Lines cleared by a placement
+	bool gameover;
+	int n;
+
+	assert(game != NULL);
+	if (depth == 0) {
+		return 1;
+	}
+	key = game->hash ^ tt_key(PF_DEPTHKEY + depth);
+	if (depth > 1 && tt_probe(&pf_tt, key, &count)) {
+		pf_stats.hits++;
+		return (unsigned long) count;
+	}
+	n = p_genmoves(game, moves, P_MAXMOVES);
+	pf_stats.gens++;
+	if (n > P_MAXMOVES) {
+		b_error("Error: more than %d moves\n", P_MAXMOVES);
+	}
+	if (depth == 1) {
+		return (unsigned long) n;
+	}
+	if (!g_snapshot(game, &snap)) {
+		b_error("Error: board too big to search\n");
+	}
+	for (int i = 0; i < n; i++) {
+		gameover = false;
+		lines = p_place(game, &moves[i], pf_shape(ply + 2), NORTH, 
+				&gameover);
+		s_award(game, lines, PF_LEVEL, 0, 1);
+		if (!gameover) {
+			nodes += pf_perft(game, depth - 1, ply + 1);
+		}
+		g_restore(game, &snap);
+	}
+	tt_store(&pf_tt, key, nodes);
+	return nodes;
+}
+
+/*
+ *	Returns the shape of the piece placed at the given ply.
+ */
+int
+pf_shape(int ply) {
+	return ply % p_nshapes();
+}
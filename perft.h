@@ -0,0 +1,17 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <stdbool.h>, <SDL/SDL.h>
+ *
+ *	Definitions for counting placements, to test and time the move generator.
+ */
+
+#ifndef PERFT_H
+#define PERFT_H
+
+#define PF_MAXDEPTH	8		// Deepest search allowed
+
+// Function prototypes
+extern void pf_run(int w, int h, int depth);
+
+#endif // PERFT_H
@@ -6,282 +6,428 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "SDL.h"
 #include "audio.h"
+#include "bloc.h"
 #include "board.h"
 #include "piece.h"
+#include "rng.h"
+#include "score.h"
+#include "game.h"
+#include "tt.h"
 
-#define P_W		4		// Piece size, in blocks
-#define P_H		4
-#define P_XORG	3		// Game piece starting position
-#define P_YORG	0
+#define P_W		5		// Size of the grid shapes are drawn in, in blocks
+#define P_H		5
+#define P_YORG	0		// Game piece starting position, centred in x
+#define P_XORG(w)	(((w) - p_set.size) / 2)
 #define P_NEXTX	12		// Next piece's position relative to the board
 #define P_NEXTY	1
+#define P_ROWBITS	((1 << P_W) - 1)	// Blocks in one row of a piece
+#define P_MAXSHAPES	64		// Maximum number of shapes, one bit each in a bag
+#define P_MAXFILE	8192	// Maximum size of a shapes file
+#define P_READONLY	"r"		// Open file read only
+#define P_TETROMINOES	"tetrominoes"	// Names of the built-in shape sets
+#define P_PENTOMINOES	"pentominoes"
+#define P_CURKEY	(1ULL << 40)	// Hash keys for the current and next
+#define P_NEXTKEY	(1ULL << 41)	// pieces' shapes, apart from all others
 
-// Tetrimino game piece
+// Row j of a piece's mask, as bits
+#define P_ROW(m, j)	(((m) >> ((j) * P_W)) & P_ROWBITS)
+
+// Bit for the block in column i of row j of a piece's mask
+#define P_BIT(i, j)	(((Uint32) 1) << ((i) + (j) * P_W))
+
+// Piece's blocks in one rotation
 typedef struct {
-	bd_col_t	col;	// Colour
-	p_rot_t		rot;	// Rotation
-	int			x;		// X position, in blocks
-	int			y;		// Y position
-} piece_t;
+	Uint32	mask;		// Blocks, bit i + j * P_W for column i of row j
+	Uint8	minx;		// Bounding box of the blocks
+	Uint8	maxx;
+	Uint8	miny;
+	Uint8	maxy;
+} p_shape_t;
+
+/*
+ *	The set of shapes pieces are made from.  Only the NORTH rotation of each 
+ *	shape is given, the others are generated when the set is loaded by 
+ *	turning the shape clockwise and centring it on the NORTH rotation's 
+ *	bounding box.  Checking the edges of the board and collisions then only 
+ *	look at the rows a piece covers, each a shift and an AND, however the 
+ *	shapes were made.  Shapes are picked at random or, if bag is set, dealt 
+ *	from a bag holding one of each.
+ */
+static struct {
+	bool		bag;						// Deal shapes from a bag
+	int			n;							// Number of shapes
+	int			size;						// Size of grid used by all shapes
+	bd_col_t	col[P_MAXSHAPES];			// Colour of each shape
+	p_shape_t	rots[P_MAXSHAPES][P_ROTS];	// Indexed by shape and rotation
+} p_set;
+
+/*
+ *	Built-in shape sets, in the same format as a shapes file.  Each shape is 
+ *	a grid of rows, '.' for no block or a colour from 1 to 7 for a block.  
+ *	Shapes are separated by blank lines and lines starting with '#' are 
+ *	ignored.  The Tetriminos are in the order of their colours and match 
+ *	the original game.
+ */
+static const char p_tetrominoes[] =
+	"# BLUE\n" "111\n" "..1\n" "\n"
+	"# CYAN\n" "2222\n" "\n"
+	"# GREEN\n" ".33\n" "33\n" "\n"
+	"# PURPLE\n" "444\n" ".4\n" "\n"
+	"# RED\n" "55\n" ".55\n" "\n"
+	"# ORANGE\n" "666\n" "6\n" "\n"
+	"# YELLOW\n" ".77\n" ".77\n";
 
-// The main game piece
-static piece_t piece;
+static const char p_pentominoes[] =
+	"# F\n" ".11\n" "11\n" ".1\n" "\n"
+	"# F'\n" "22\n" ".22\n" ".2\n" "\n"
+	"# I\n" "33333\n" "\n"
+	"# L\n" "4444\n" "4\n" "\n"
+	"# L'\n" "5555\n" "...5\n" "\n"
+	"# N\n" "66\n" ".666\n" "\n"
+	"# N'\n" "..77\n" "777\n" "\n"
+	"# P\n" "11\n" "11\n" "1\n" "\n"
+	"# P'\n" "22\n" "22\n" ".2\n" "\n"
+	"# T\n" "333\n" ".3\n" ".3\n" "\n"
+	"# U\n" "4.4\n" "444\n" "\n"
+	"# V\n" "5\n" "5\n" "555\n" "\n"
+	"# W\n" "6\n" "66\n" ".66\n" "\n"
+	"# X\n" ".7\n" "777\n" ".7\n" "\n"
+	"# Y\n" "1111\n" ".1\n" "\n"
+	"# Y'\n" "2222\n" "..2\n" "\n"
+	"# Z\n" "33\n" ".3\n" ".33\n" "\n"
+	"# Z'\n" ".44\n" ".4\n" "44\n";
 
-// The next game piece
-static piece_t nextpiece;
+// Function prototypes
+static void p_parse(const char *text, const char *name);
+static void p_addshape(Uint32 mask, bd_col_t col, const char *name);
+static p_shape_t p_box(Uint32 mask);
+static p_shape_t p_turn(const p_shape_t *shape, const p_shape_t *north);
+static int p_centre(int centre, int len);
+static void p_copynext(bloc_game_t *game);
+static void p_getnext(bloc_game_t *game);
+static void p_fits(const bloc_game_t *game, const p_shape_t *shape, 
+		bd_row_t *fit);
+static void p_reachrow(bd_row_t reach[P_ROTS][BD_MAXH + 1], 
+		bd_row_t fit[P_ROTS][BD_MAXH + 1], const p_shape_t *rots, int y);
+static bool p_isoffbrd(const bloc_game_t *game, const piece_t *piece, int x, 
+		int y, p_rot_t rot);
+static bool p_iscollide(const bloc_game_t *game, const piece_t *piece, int x, 
+		int y, p_rot_t rot);
+static void p_copytobd(bloc_game_t *game);
+static int p_dropdist(const bloc_game_t *game, const piece_t *piece);
+static void p_drawpiece(SDL_Surface *screen, SDL_Surface *blocks, 
+		const piece_t *piece, Uint32 fall);
+static bd_row_t p_rowbits(const p_shape_t *shape, int x, int j);
+static int p_randshape(bloc_game_t *game);
+static p_rot_t p_randrot(bloc_game_t *game);
+static unsigned p_count(Uint64 bag);
 
 /*
- *	Pre-baked block data for Tetriminos game pieces.  Each piece is associated 
- *	with a 4x4 array of blocks.  Each array of blocks is indexed by the pieces 
- *	colour and rotation, making a four-dimensional array.  The colour CLEAR is 
- *	included to make indexing easier.
+ *	Load the set of shapes pieces are made from and generate their 
+ *	rotations.  Must be called once before any games are started.
+ *	name	- P_TETROMINOES, P_PENTOMINOES or a shapes file, NULL for the 
+ *			  Tetriminos
  */
-static const bd_col_t p_blocks[BD_COLS][P_ROTS][P_H][P_W] = {
-	{
-		// CLEAR
-		{
-			{ 0 }
-		}
-	}, {
-		// BLUE
-		{
-			// NORTH
-			{ BLUE,		BLUE,	BLUE,	CLEAR },
-			{ CLEAR,	CLEAR,	BLUE,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// EAST
-			{ CLEAR,	BLUE,	CLEAR,	CLEAR },
-			{ CLEAR,	BLUE,	CLEAR,	CLEAR },
-			{ BLUE,		BLUE,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// SOUTH
-			{ BLUE,		CLEAR,	CLEAR,	CLEAR },
-			{ BLUE,		BLUE,	BLUE,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// WEST
-			{ BLUE,		BLUE,	CLEAR,	CLEAR },
-			{ BLUE,		CLEAR,	CLEAR,	CLEAR },
-			{ BLUE,		CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}
-	}, {
-		// CYAN
-		{
-			// NORTH
-			{ CYAN,		CYAN,	CYAN,	CYAN },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// EAST
-			{ CLEAR,	CYAN,	CLEAR,	CLEAR },
-			{ CLEAR,	CYAN,	CLEAR,	CLEAR },
-			{ CLEAR,	CYAN,	CLEAR,	CLEAR },
-			{ CLEAR,	CYAN,	CLEAR,	CLEAR }
-		}, {
-			// SOUTH
-			{ CYAN,		CYAN,	CYAN,	CYAN },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// WEST
-			{ CLEAR,	CYAN,	CLEAR,	CLEAR },
-			{ CLEAR,	CYAN,	CLEAR,	CLEAR },
-			{ CLEAR,	CYAN,	CLEAR,	CLEAR },
-			{ CLEAR,	CYAN,	CLEAR,	CLEAR }
+void
+p_loadshapes(const char *name) {
+	FILE *fp;					// Shapes file
+	static char text[P_MAXFILE];	// Contents of the shapes file
+	size_t len;
+
+	if (name == NULL || strcmp(name, P_TETROMINOES) == 0) {
+		p_parse(p_tetrominoes, P_TETROMINOES);
+		return;
+	}
+	if (strcmp(name, P_PENTOMINOES) == 0) {
+		p_parse(p_pentominoes, P_PENTOMINOES);
+		return;
+	}
+	fp = fopen(name, P_READONLY);
+	if (fp == NULL) {
+		b_error("Error opening shapes file %s\n", name);
+	}
+	len = fread(text, 1, P_MAXFILE, fp);
+	if (ferror(fp)) {
+		b_error("Error reading shapes file %s\n", name);
+	}
+	if (len == P_MAXFILE) {
+		b_error("Error: shapes file %s is too big\n", name);
+	}
+	if (fclose(fp) == EOF) {
+		fprintf(stderr, "Error closing shapes file %s\n", name);
+	}
+	text[len] = '\0';
+	p_parse(text, name);
+}
+
+/*
+ *	Choose how shapes are dealt, from a bag holding one of every shape or 
+ *	each picked at random.
+ */
+void
+p_usebag(bool bag) {
+	p_set.bag = bag;
+}
+
+/*
+ *	Returns the size of the grid all the shapes fit in, the board must be at 
+ *	least this big.
+ */
+int
+p_size(void) {
+	assert(p_set.n > 0);
+	return p_set.size;
+}
+
+/*
+ *	Returns the number of shapes in the set.
+ */
+int
+p_nshapes(void) {
+	assert(p_set.n > 0);
+	return p_set.n;
+}
+
+/*
+ *	Returns a piece's blocks, bit i + j * P_W for column i of row j of the 
+ *	grid it is drawn in.
+ */
+Uint32
+p_mask(const piece_t *piece) {
+	assert(piece != NULL);
+	return p_set.rots[piece->shape][piece->rot].mask;
+}
+
+/*
+ *	Read the shapes from the text of a shapes file, see p_tetrominoes for 
+ *	the format.  Any error is fatal.
+ *	name	- where the text came from, for error messages
+ */
+void
+p_parse(const char *text, const char *name) {
+	const char *end;	// End of the line being read
+	Uint32 mask = 0;	// Blocks of the shape being read
+	bd_col_t col = CLEAR;
+	int j = 0;			// Row of the shape being read
+
+	assert(text != NULL && name != NULL);
+	p_set.n = 0;
+	p_set.size = 0;
+	for ( ; *text != '\0'; text = (*end == '\n') ? end + 1 : end) {
+		end = text + strcspn(text, "\n");
+		if (*text == '#') {
+			continue;
 		}
-	}, {
-		// GREEN
-		{
-			// NORTH
-			{ CLEAR,	GREEN,	GREEN,	CLEAR },
-			{ GREEN,	GREEN,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// EAST
-			{ GREEN,	CLEAR,	CLEAR,	CLEAR },
-			{ GREEN,	GREEN,	CLEAR,	CLEAR },
-			{ CLEAR,	GREEN,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// SOUTH
-			{ CLEAR,	GREEN,	GREEN,	CLEAR },
-			{ GREEN,	GREEN,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// WEST
-			{ GREEN,	CLEAR,	CLEAR,	CLEAR },
-			{ GREEN,	GREEN,	CLEAR,	CLEAR },
-			{ CLEAR,	GREEN,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
+		if (end == text) {
+			if (j > 0) {
+				p_addshape(mask, col, name);
+			}
+			mask = 0;
+			col = CLEAR;
+			j = 0;
+			continue;
 		}
-	}, {
-		// PURPLE
-		{
-			// NORTH
-			{ PURPLE,	PURPLE,	PURPLE,	CLEAR },
-			{ CLEAR,	PURPLE,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// EAST
-			{ CLEAR,	PURPLE,	CLEAR,	CLEAR },
-			{ PURPLE,	PURPLE,	CLEAR,	CLEAR },
-			{ CLEAR,	PURPLE,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// SOUTH
-			{ CLEAR,	PURPLE,	CLEAR,	CLEAR },
-			{ PURPLE,	PURPLE,	PURPLE,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// WEST
-			{ PURPLE,	CLEAR,	CLEAR,	CLEAR },
-			{ PURPLE,	PURPLE,	CLEAR,	CLEAR },
-			{ PURPLE,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
+		if (j >= P_H || end - text > P_W) {
+			b_error("Error: shape %d in %s is bigger than %dx%d\n", 
+					p_set.n + 1, name, P_W, P_H);
 		}
-	}, {
-		// RED
-		{
-			// NORTH
-			{ RED,		RED,	CLEAR,	CLEAR },
-			{ CLEAR,	RED,	RED,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// EAST
-			{ CLEAR,	RED,	CLEAR,	CLEAR },
-			{ RED,		RED,	CLEAR,	CLEAR },
-			{ RED,		CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// SOUTH
-			{ RED,		RED,	CLEAR,	CLEAR },
-			{ CLEAR,	RED,	RED,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// WEST
-			{ CLEAR,	RED,	CLEAR,	CLEAR },
-			{ RED,		RED,	CLEAR,	CLEAR },
-			{ RED,		CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
+		for (int i = 0; text + i < end; i++) {
+			if (text[i] == '.') {
+				continue;
+			}
+			if (text[i] < '1' || text[i] >= '0' + BD_COLS
+			||  (col != CLEAR && col != (bd_col_t) (text[i] - '0'))) {
+				b_error("Error: bad block '%c' in shape %d in %s\n", text[i], 
+						p_set.n + 1, name);
+			}
+			col = (bd_col_t) (text[i] - '0');
+			mask |= P_BIT(i, j);
 		}
-	}, {
-		// ORANGE
-		{
-			// NORTH
-			{ ORANGE,	ORANGE,	ORANGE,	CLEAR },
-			{ ORANGE,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// EAST
-			{ ORANGE,	ORANGE,	CLEAR,	CLEAR },
-			{ CLEAR,	ORANGE,	CLEAR,	CLEAR },
-			{ CLEAR,	ORANGE,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR } 
-		}, {
-			// SOUTH
-			{ CLEAR,	CLEAR,	ORANGE,	CLEAR },
-			{ ORANGE,	ORANGE,	ORANGE,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// WEST
-			{ ORANGE,	CLEAR,	CLEAR,	CLEAR },
-			{ ORANGE,	CLEAR,	CLEAR,	CLEAR },
-			{ ORANGE,	ORANGE,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
+		j++;
+	}
+	if (j > 0) {
+		p_addshape(mask, col, name);
+	}
+	if (p_set.n == 0) {
+		b_error("Error: no shapes in %s\n", name);
+	}
+}
+
+/*
+ *	Add a shape to the set and generate its rotations.
+ *	mask	- the shape's NORTH rotation
+ */
+void
+p_addshape(Uint32 mask, bd_col_t col, const char *name) {
+	p_shape_t *rots;
+
+	assert(name != NULL);
+	if (mask == 0) {
+		b_error("Error: shape %d in %s has no blocks\n", p_set.n + 1, name);
+	}
+	if (p_set.n >= P_MAXSHAPES) {
+		b_error("Error: more than %d shapes in %s\n", P_MAXSHAPES, name);
+	}
+	p_set.col[p_set.n] = col;
+	rots = p_set.rots[p_set.n];
+	rots[NORTH] = p_box(mask);
+	for (int r = NORTH + 1; r < P_ROTS; r++) {
+		rots[r] = p_turn(&rots[r-1], &rots[NORTH]);
+	}
+	for (int r = NORTH; r < P_ROTS; r++) {
+		p_set.size = MAX(p_set.size, MAX(rots[r].maxx, rots[r].maxy) + 1);
+	}
+	p_set.n++;
+}
+
+/*
+ *	Returns the shape with the given blocks, working out its bounding box.
+ */
+p_shape_t
+p_box(Uint32 mask) {
+	p_shape_t shape = { mask, P_W - 1, 0, P_H - 1, 0 };
+
+	assert(mask != 0);
+	for (int j = 0; j < P_H; j++) {
+		for (int i = 0; i < P_W; i++) {
+			if (mask & P_BIT(i, j)) {
+				shape.minx = MIN(shape.minx, i);
+				shape.maxx = MAX(shape.maxx, i);
+				shape.miny = MIN(shape.miny, j);
+				shape.maxy = MAX(shape.maxy, j);
+			}
 		}
-	}, {
-		// YELLOW
-		{
-			// NORTH
-			{ CLEAR,	YELLOW,	YELLOW,	CLEAR },
-			{ CLEAR,	YELLOW,	YELLOW,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// EAST
-			{ CLEAR,	YELLOW,	YELLOW,	CLEAR },
-			{ CLEAR,	YELLOW,	YELLOW,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// SOUTH
-			{ CLEAR,	YELLOW,	YELLOW,	CLEAR },
-			{ CLEAR,	YELLOW,	YELLOW,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
-		}, {
-			// WEST
-			{ CLEAR,	YELLOW,	YELLOW,	CLEAR },
-			{ CLEAR,	YELLOW,	YELLOW,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR },
-			{ CLEAR,	CLEAR,	CLEAR,	CLEAR }
+	}
+	return shape;
+}
+
+/*
+ *	Returns the shape turned clockwise.  The turned shape's bounding box is 
+ *	centred on the bounding box of the NORTH rotation, so pieces turn about 
+ *	the same point whatever their rotation.
+ */
+p_shape_t
+p_turn(const p_shape_t *shape, const p_shape_t *north) {
+	Uint32 mask = 0;	// Blocks of the turned shape
+	int x, y;			// Top left of the turned shape's bounding box
+
+	assert(shape != NULL && north != NULL);
+	x = p_centre(north->minx + north->maxx, shape->maxy - shape->miny + 1);
+	y = p_centre(north->miny + north->maxy, shape->maxx - shape->minx + 1);
+	for (int j = shape->miny; j <= shape->maxy; j++) {
+		for (int i = shape->minx; i <= shape->maxx; i++) {
+			if (shape->mask & P_BIT(i, j)) {
+				mask |= P_BIT(x + shape->maxy - j, y + i - shape->minx);
+			}
 		}
 	}
-};
+	return p_box(mask);
+}
 
-// Function prototypes
-static void p_copynext(void);
-static void p_getnext(void);
-static bool p_isoffbrd(int x, int y, p_rot_t rot);
-static bool p_iscollide(int x, int y, p_rot_t rot);
-static void p_copytobd(void);
-static void p_drawpiece(SDL_Surface *screen, SDL_Surface *blocks, 
-		piece_t *piece);
-static bd_col_t p_randcol(void);
-static p_rot_t p_randrot(void);
+/*
+ *	Returns where a line of blocks should start so it is centred on the 
+ *	given point, rounding towards the top left and keeping the line in the 
+ *	grid.
+ *	centre	- the point to centre on, doubled so it's a whole number
+ *	len		- the line's length
+ */
+int
+p_centre(int centre, int len) {
+	int start;		// Doubled start of the line
+
+	start = centre - (len - 1);
+	start = (start >= 0) ? start / 2 : (start - 1) / 2;
+	return MAX(0, MIN(start, P_W - len));
+}
 
 /*
  *	Get the pseudo-random game and next pieces and set their starting 
- *	positions.  srand should've been called.
+ *	positions.  Their shapes are added to the game's hash, which must be 
+ *	for an empty board.  The game's generator should've been seeded, the bag 
+ *	is emptied.
  */
 void
-p_init(void) {
-	piece.col = p_randcol();
-	piece.rot = p_randrot();
-	piece.x = P_XORG;
-	piece.y = P_YORG;
-	p_getnext();
+p_init(bloc_game_t *game) {
+	int shape;
+	p_rot_t rot;
+
+	assert(game != NULL);
+	game->bag = 0;
+	shape = p_randshape(game);
+	rot = p_randrot(game);
+	p_start(game, shape, rot);
+	p_getnext(game);
+}
+
+/*
+ *	Put the given game piece at its starting position, as the game's first 
+ *	piece.  Its shape is added to the game's hash, which must be for an 
+ *	empty board.  The next piece must be set after, with p_setnext.
+ */
+void
+p_start(bloc_game_t *game, int shape, p_rot_t rot) {
+	assert(game != NULL && shape >= 0 && shape < p_set.n);
+	game->pieces = 1;
+	game->piece.shape = shape;
+	game->hash ^= tt_key(P_CURKEY + shape);
+	game->piece.col = p_set.col[shape];
+	game->piece.rot = rot;
+	game->piece.x = P_XORG(game->board.w);
+	game->piece.y = P_YORG;
 }
 
 /*
  *	Copy the next game piece to the current game piece and move it onto the 
- *	game board.
+ *	game board.  The shapes of both pieces are taken out of the game's hash 
+ *	and the new current piece's shape put in, p_getnext adds the new next 
+ *	piece.  The piece is counted in the game's pieces.
+ */
+void
+p_copynext(bloc_game_t *game) {
+	assert(game != NULL);
+	game->pieces++;
+	game->hash ^= tt_key(P_CURKEY + game->piece.shape) 
+		^ tt_key(P_NEXTKEY + game->nextpiece.shape) 
+		^ tt_key(P_CURKEY + game->nextpiece.shape);
+	game->piece.shape = game->nextpiece.shape;
+	game->piece.col = game->nextpiece.col;
+	game->piece.rot = game->nextpiece.rot;
+	game->piece.x = P_XORG(game->board.w);
+	game->piece.y = P_YORG;
+}
+
+/*
+ *	Get a pseudo-random next piece.
  */
 void
-p_copynext(void) {
-	piece.col = nextpiece.col;
-	piece.rot = nextpiece.rot;
-	piece.x = P_XORG;
-	piece.y = P_YORG;
+p_getnext(bloc_game_t *game) {
+	int shape;
+	p_rot_t rot;
+
+	assert(game != NULL);
+	shape = p_randshape(game);
+	rot = p_randrot(game);
+	p_setnext(game, shape, rot);
 }
 
 /*
- *	Get a pseudo-random next piece and set it's starting position.  srand 
- *	should've been called.
+ *	Set the next piece and its starting position, its shape is added to the 
+ *	game's hash.  The old next piece must have been moved on to the board.
  */
 void
-p_getnext(void) {
-	nextpiece.col = p_randcol();
-	nextpiece.rot = p_randrot();
-	nextpiece.x = P_NEXTX;
-	nextpiece.y = P_NEXTY;
+p_setnext(bloc_game_t *game, int shape, p_rot_t rot) {
+	assert(game != NULL && shape >= 0 && shape < p_set.n);
+	game->nextpiece.shape = shape;
+	game->hash ^= tt_key(P_NEXTKEY + shape);
+	game->nextpiece.col = p_set.col[shape];
+	game->nextpiece.rot = rot;
+	game->nextpiece.x = P_NEXTX;
+	game->nextpiece.y = P_NEXTY;
 }
 
 /*
@@ -290,10 +436,14 @@ p_getnext(void) {
  *	The move is ignored if it does.
  */
 void
-p_movex(int x) {
-	if (!p_isoffbrd(piece.x + x, piece.y, piece.rot)
-	&&  !p_iscollide(piece.x + x, piece.y, piece.rot)) {
-		piece.x += x;
+p_movex(bloc_game_t *game, int x) {
+	piece_t *piece;
+
+	assert(game != NULL);
+	piece = &game->piece;
+	if (!p_isoffbrd(game, piece, piece->x + x, piece->y, piece->rot)
+	&&  !p_iscollide(game, piece, piece->x + x, piece->y, piece->rot)) {
+		piece->x += x;
 	}
 }
 
@@ -305,17 +455,19 @@ p_movex(int x) {
  *	gameover - set to true if the game is over
  */
 unsigned
-p_movey(int y, bool *gameover) {
+p_movey(bloc_game_t *game, int y, bool *gameover) {
+	piece_t *piece;
 	unsigned lines = 0;		// Number of full lines
 
-	assert(gameover != NULL);
-	if (p_isoffbrd(piece.x, piece.y + y, piece.rot)
-	||  p_iscollide(piece.x, piece.y + y, piece.rot)) {
-		p_copytobd();
-		lines = bd_chkfull(piece.y, piece.y + P_H - 1);
-		p_copynext();
-		p_getnext();
-		if (p_iscollide(piece.x, piece.y, piece.rot)) {
+	assert(game != NULL && gameover != NULL);
+	piece = &game->piece;
+	if (p_isoffbrd(game, piece, piece->x, piece->y + y, piece->rot)
+	||  p_iscollide(game, piece, piece->x, piece->y + y, piece->rot)) {
+		p_copytobd(game);
+		lines = bd_chkfull(game, piece->y, piece->y + p_set.size - 1);
+		p_copynext(game);
+		p_getnext(game);
+		if (p_iscollide(game, piece, piece->x, piece->y, piece->rot)) {
 			*gameover = true;
 		}
 		if (*gameover) {
@@ -324,35 +476,65 @@ p_movey(int y, bool *gameover) {
 			a_play(A_LINE);
 		}
 	} else {
-		piece.y += y;
+		piece->y += y;
 	}
 	return lines;
 }
 
+/*
+ *	Returns true if the piece can't move down any further.
+ */
+bool
+p_isresting(const bloc_game_t *game) {
+	const piece_t *piece;
+
+	assert(game != NULL);
+	piece = &game->piece;
+	return p_isoffbrd(game, piece, piece->x, piece->y + 1, piece->rot)
+		|| p_iscollide(game, piece, piece->x, piece->y + 1, piece->rot);
+}
+
+/*
+ *	Move the piece up a line at a time until it is clear of the blocks on 
+ *	the board, after lines have been pushed up under it.  Its grid can end 
+ *	up above the board, y < 0, if its top row is empty.
+ *	gameover	- set to true if the piece can't be moved clear
+ */
+void
+p_lift(bloc_game_t *game, bool *gameover) {
+	piece_t *piece;
+
+	assert(game != NULL && gameover != NULL);
+	piece = &game->piece;
+	while (p_iscollide(game, piece, piece->x, piece->y, piece->rot)) {
+		if (p_isoffbrd(game, piece, piece->x, piece->y - 1, piece->rot)) {
+			*gameover = true;
+			a_play(A_GAMEOVER);
+			return;
+		}
+		piece->y--;
+	}
+}
+
 /*
  *	Hard drop the piece into place.  Returns the number of full lines.
  *	gameover	- set to true if the game is over
  *	dist		- set to the distance the piece was dropped.
  */
 unsigned 
-p_harddrop(bool *gameover, unsigned *dist) {
-	int i;
+p_harddrop(bloc_game_t *game, bool *gameover, unsigned *dist) {
+	piece_t *piece;
 	unsigned lines;		// Number of full lines
 
-	assert(gameover != NULL && dist != NULL);
-	for (i = 1;
-		 !p_isoffbrd(piece.x, piece.y + i, piece.rot)
-	  && !p_iscollide(piece.x, piece.y + i, piece.rot);
-		 i++) {
-		// VOID
-	}
-	*dist = i - 1;
-	piece.y += *dist;
-	p_copytobd();
-	lines = bd_chkfull(piece.y, piece.y + P_H - 1);
-	p_copynext();
-	p_getnext();
-	if (p_iscollide(piece.x, piece.y, piece.rot)) {
+	assert(game != NULL && gameover != NULL && dist != NULL);
+	piece = &game->piece;
+	*dist = p_dropdist(game, piece);
+	piece->y += *dist;
+	p_copytobd(game);
+	lines = bd_chkfull(game, piece->y, piece->y + p_set.size - 1);
+	p_copynext(game);
+	p_getnext(game);
+	if (p_iscollide(game, piece, piece->x, piece->y, piece->rot)) {
 		*gameover = true;
 	}
 	if (*gameover) {
@@ -365,98 +547,332 @@ p_harddrop(bool *gameover, unsigned *dist) {
 	return lines;
 }
 
+/*
+ *	Lock the piece into place at the given position without any sound.  
+ *	Full lines are removed straight away, then the next piece is moved on to 
+ *	the board and the given piece becomes the next piece.  Returns the number 
+ *	of lines removed.
+ *	move		- where to place the piece, from p_genmoves
+ *	shape, rot	- the new next piece
+ *	gameover	- set to true if the game is over
+ */
+unsigned
+p_place(bloc_game_t *game, const p_move_t *move, int shape, p_rot_t rot, 
+		bool *gameover) {
+	piece_t *piece;
+	unsigned lines;		// Number of lines removed
+
+	assert(game != NULL && move != NULL && gameover != NULL);
+	piece = &game->piece;
+	piece->x = move->x;
+	piece->y = move->y;
+	piece->rot = move->rot;
+	p_copytobd(game);
+	lines = bd_flush(game);
+	p_copynext(game);
+	p_setnext(game, shape, rot);
+	if (p_iscollide(game, piece, piece->x, piece->y, piece->rot)) {
+		*gameover = true;
+	}
+	return lines;
+}
+
+/*
+ *	List every place the game piece can come to rest in, using the same 
+ *	rules as p_movex, p_rot and p_movey so pieces can be slid and turned 
+ *	under overhangs.  Places where different rotations cover the same blocks 
+ *	are only listed once.  Returns the number of places, only the first max 
+ *	are stored in moves.
+ *
+ *	Rather than trying each move in turn, every row of the board has a mask 
+ *	for each rotation of the x positions the piece fits in, one bit for each 
+ *	position of the left of its bounding box.  The positions the piece can 
+ *	reach are flooded through these masks a row at a time, sideways and 
+ *	turning within a row then down into the next row, as the piece can 
+ *	never move up.  The piece lands wherever it can be reached but doesn't 
+ *	fit one row further down.  A piece p_lift has left above the board, 
+ *	y < 0, is searched from row 0, as if it had fallen there, so it has no 
+ *	places if it doesn't fit there.
+ */
+int
+p_genmoves(const bloc_game_t *game, p_move_t *moves, int max) {
+	const p_shape_t *rots;
+	bd_row_t fit[P_ROTS][BD_MAXH + 1];		// Where the piece fits
+	bd_row_t reach[P_ROTS][BD_MAXH + 1];	// Where the piece can get to
+	bd_row_t land;							// Where the piece lands
+	bd_row_t dup;							// Places listed already
+	int same[P_ROTS];		// Earlier rotation covering the same blocks
+	int n = 0;				// Number of places found
+	int y, dy;
+
+	assert(game != NULL && moves != NULL);
+	rots = p_set.rots[game->piece.shape];
+	for (int r = 0; r < P_ROTS; r++) {
+		p_fits(game, &rots[r], fit[r]);
+		for (y = 0; y <= game->board.h; y++) {
+			reach[r][y] = 0;
+		}
+		same[r] = -1;
+		for (int s = 0; s < r && same[r] < 0; s++) {
+			if (rots[s].mask >> (rots[s].minx + rots[s].miny * P_W) 
+			==  rots[r].mask >> (rots[r].minx + rots[r].miny * P_W)) {
+				same[r] = s;
+			}
+		}
+	}
+	y = MAX(game->piece.y, 0);
+	reach[game->piece.rot][y] = fit[game->piece.rot][y] 
+		& ((bd_row_t) 1 << (game->piece.x + rots[game->piece.rot].minx));
+	for ( ; y < game->board.h; y++) {
+		p_reachrow(reach, fit, rots, y);
+	}
+	for (int r = 0; r < P_ROTS; r++) {
+		for (y = 0; y < game->board.h; y++) {
+			land = reach[r][y] & ~fit[r][y+1];
+			if (same[r] >= 0) {
+				dy = y + rots[r].miny - rots[same[r]].miny;
+				if (dy >= 0 && dy < game->board.h) {
+					dup = reach[same[r]][dy] & ~fit[same[r]][dy+1];
+					land &= ~dup;
+				}
+			}
+			for (int bx = 0; land != 0; bx++, land >>= 1) {
+				if ((land & 1) == 0) {
+					continue;
+				}
+				if (n < max) {
+					moves[n].x = bx - rots[r].minx;
+					moves[n].y = y;
+					moves[n].rot = (p_rot_t) r;
+				}
+				n++;
+			}
+		}
+	}
+	return n;
+}
+
+/*
+ *	Work out, for every row of the board, the x positions the shape fits in 
+ *	when its top is on that row.  Bit x is set if the left of the shape's 
+ *	bounding box can be at x.  Rows where the shape would go off the bottom 
+ *	of the board, up to and including row h, are left empty.  Only rows 
+ *	from 0 down are worked out, a shape poking above the top isn't.
+ */
+void
+p_fits(const bloc_game_t *game, const p_shape_t *shape, bd_row_t *fit) {
+	bd_row_t edge;		// Where the shape is on the board
+	bd_row_t line;		// Blocks of the shape's row
+	int y;
+
+	assert(game != NULL && shape != NULL && fit != NULL);
+	edge = game->board.full >> (shape->maxx - shape->minx);
+	for (y = 0; y + shape->maxy < game->board.h; y++) {
+		fit[y] = edge;
+		for (int j = shape->miny; j <= shape->maxy; j++) {
+			line = P_ROW(shape->mask, j) >> shape->minx;
+			for (int i = 0; line != 0; i++, line >>= 1) {
+				if (line & 1) {
+					fit[y] &= ~(BD_ROW(game, y + j) >> i);
+				}
+			}
+		}
+	}
+	for ( ; y <= game->board.h; y++) {
+		fit[y] = 0;
+	}
+}
+
+/*
+ *	Flood the places the piece can reach in row y, moving sideways and 
+ *	turning, then move them down into the next row where the piece fits.
+ */
+void
+p_reachrow(bd_row_t reach[P_ROTS][BD_MAXH + 1], 
+		bd_row_t fit[P_ROTS][BD_MAXH + 1], const p_shape_t *rots, int y) {
+	bd_row_t r, old;	// Places reached in one rotation
+	bd_row_t turned;	// Places reached by turning
+	bool changed;		// Whether any new places were reached
+	int to, sh;
+
+	assert(reach != NULL && fit != NULL && rots != NULL);
+	do {
+		changed = false;
+		for (int rot = 0; rot < P_ROTS; rot++) {
+			if (reach[rot][y] == 0) {
+				continue;
+			}
+			r = reach[rot][y];
+			do {
+				old = r;
+				r |= ((r << 1) | (r >> 1)) & fit[rot][y];
+			} while (r != old);
+			reach[rot][y] = r;
+			for (int vel = -1; vel <= 1; vel += 2) {
+				to = (rot + vel + P_ROTS) % P_ROTS;
+				sh = rots[to].minx - rots[rot].minx;
+				turned = (sh >= 0) ? r << sh : r >> -sh;
+				turned &= fit[to][y];
+				if (turned & ~reach[to][y]) {
+					reach[to][y] |= turned;
+					changed = true;
+				}
+			}
+		}
+	} while (changed);
+	for (int rot = 0; rot < P_ROTS; rot++) {
+		reach[rot][y+1] = reach[rot][y] & fit[rot][y+1];
+	}
+}
+
+/*
+ *	Returns the distance the piece can fall before it lands.  If every block 
+ *	of the piece is above the highest block in its column, the distance comes 
+ *	straight from the column heights.  Otherwise the piece is tucked under an 
+ *	overhang and is tried a row at a time.  Columns of a loaded shape with no 
+ *	blocks in, such as the middle of x.x, are skipped.
+ */
+int
+p_dropdist(const bloc_game_t *game, const piece_t *piece) {
+	const p_shape_t *shape;
+	int dist;			// Distance the piece can fall
+	int bottom;			// Lowest block of the piece in this column
+	int top;			// Highest block on the board in this column
+
+	assert(game != NULL && piece != NULL);
+	shape = &p_set.rots[piece->shape][piece->rot];
+	dist = game->board.h;
+	for (int i = shape->minx; i <= shape->maxx; i++) {
+		for (bottom = shape->maxy; bottom >= shape->miny 
+				&& (P_ROW(shape->mask, bottom) >> i & 1) == 0; bottom--) {
+			// VOID
+		}
+		if (bottom < shape->miny) {
+			continue;
+		}
+		top = bd_top(game, piece->x + i);
+		if (piece->y + bottom >= top) {
+			dist = -1;
+			break;
+		}
+		dist = MIN(dist, top - 1 - (piece->y + bottom));
+	}
+	if (dist >= 0) {
+		return dist;
+	}
+	for (dist = 1;
+		 !p_isoffbrd(game, piece, piece->x, piece->y + dist, piece->rot)
+	  && !p_iscollide(game, piece, piece->x, piece->y + dist, piece->rot);
+		 dist++) {
+		// VOID
+	}
+	return dist - 1;
+}
+
 /*
  *	Rotate the piece.  vel is the velocity and can be 1 or -1.  If the 
  *	rotation takes the piece off the board or collides with a block on the 
  *	board it is ignored.
  */
 void
-p_rot(int vel) {
+p_rot(bloc_game_t *game, int vel) {
+	piece_t *piece;
 	p_rot_t rot;
 
-	assert(vel == -1 || vel == 1);
-	if (vel > 0 && piece.rot >= P_ROTS - 1) {
+	assert(game != NULL && (vel == -1 || vel == 1));
+	piece = &game->piece;
+	if (vel > 0 && piece->rot >= P_ROTS - 1) {
 		rot = 0;
-	} else if (vel < 0 && piece.rot <= 0) {
+	} else if (vel < 0 && piece->rot <= 0) {
 		rot = P_ROTS - 1;
 	} else {
-		rot = piece.rot + vel;
+		rot = piece->rot + vel;
 	}
-	if (!p_isoffbrd(piece.x, piece.y, rot)
-	&&  !p_iscollide(piece.x, piece.y, rot)) {
-		piece.rot = rot;
+	if (!p_isoffbrd(game, piece, piece->x, piece->y, rot)
+	&&  !p_iscollide(game, piece, piece->x, piece->y, rot)) {
+		piece->rot = rot;
 	}
 }
 
 /*
  *	Returns true if the piece would be off the edge of the game board using 
- *	the given rotation and position.
+ *	the given rotation and position.  Only the bounding box of the piece's 
+ *	blocks needs to be checked.
  */
 bool
-p_isoffbrd(int x, int y, p_rot_t rot) {
-	bd_col_t col;
+p_isoffbrd(const bloc_game_t *game, const piece_t *piece, int x, int y, 
+		p_rot_t rot) {
+	const p_shape_t *shape;
 
-	for (int j = 0; j < P_H; j++) {
-		for (int i = 0; i < P_W; i++) {
-			col = p_blocks[piece.col][rot][j][i];
-			if (col != CLEAR) {
-				if (bd_isoff(x + i, y + j)) {
-					return true;
-				}
-			}
-		}
-	}
-	return false;
+	assert(game != NULL && piece != NULL);
+	shape = &p_set.rots[piece->shape][rot];
+	return bd_isoff(game, x + shape->minx, y + shape->miny)
+		|| bd_isoff(game, x + shape->maxx, y + shape->maxy);
 }
 
 /*
  *	Returns true if the piece collides with the game board, using the given 
- *	rotation and position.
+ *	rotation and position.  Each row of the piece is checked against the 
+ *	board's row with a single AND.  The piece must be on the board.
  */
 bool
-p_iscollide(int x, int y, p_rot_t rot) {
-	bd_col_t col;
+p_iscollide(const bloc_game_t *game, const piece_t *piece, int x, int y, 
+		p_rot_t rot) {
+	const p_shape_t *shape;
 
-	for (int j = 0; j < P_H; j++) {
-		for (int i = 0; i < P_W; i++) {
-			col = p_blocks[piece.col][rot][j][i];
-			if (col != CLEAR) {
-				if (bd_iscollide(x + i, y + j)) {
-					return true;
-				}
-			}
+	assert(game != NULL && piece != NULL);
+	shape = &p_set.rots[piece->shape][rot];
+	for (int j = shape->miny; j <= shape->maxy; j++) {
+		if (BD_ROW(game, y + j) & p_rowbits(shape, x, j)) {
+			return true;
 		}
 	}
 	return false;
 }
 
 /*
- *	Copy the piece to board.
+ *	Copy the piece to board, a row at a time.
  */
 void
-p_copytobd(void) {
-	bd_col_t col;
+p_copytobd(bloc_game_t *game) {
+	const piece_t *piece;
+	const p_shape_t *shape;
 
-	for (int j = 0; j < P_H; j++) {
-		for (int i = 0; i < P_W; i++) {
-			col = p_blocks[piece.col][piece.rot][j][i];
-			if (col != CLEAR) {
-				bd_copytobd(piece.x + i, piece.y + j, col);
-			}
-		}
+	assert(game != NULL);
+	piece = &game->piece;
+	shape = &p_set.rots[piece->shape][piece->rot];
+	for (int j = shape->miny; j <= shape->maxy; j++) {
+		bd_copytobd(game, piece->y + j, p_rowbits(shape, piece->x, j), 
+				piece->col);
 	}
 }
 
 /*
- *	Draw the Tetrimino game and next pieces.
+ *	Returns row j of the shape as a row of the board, with the piece at x.  
+ *	The blocks are shifted down to the bounding box first, as x can be 
+ *	negative when the piece's left columns are empty.
+ */
+bd_row_t
+p_rowbits(const p_shape_t *shape, int x, int j) {
+	assert(shape != NULL && x + shape->minx >= 0);
+	return (bd_row_t) (P_ROW(shape->mask, j) >> shape->minx) 
+		<< (x + shape->minx);
+}
+
+/*
+ *	Draw the game and next pieces.
+ *	game	- game to draw
  *	screen	- screen surface
  *	blocks	- blocks bitmap
+ *	fall	- part of a block the game piece has fallen below its position, 
+ *			  in 16.16 fixed point
  */
 void
-p_draw(SDL_Surface *screen, SDL_Surface *blocks) {
-	assert(screen != NULL && blocks != NULL);
-	p_drawpiece(screen, blocks, &piece);
-	p_drawpiece(screen, blocks, &nextpiece);
+p_draw(const bloc_game_t *game, SDL_Surface *screen, SDL_Surface *blocks, 
+		Uint32 fall) {
+	assert(game != NULL && screen != NULL && blocks != NULL);
+	p_drawpiece(screen, blocks, &game->piece, fall);
+	p_drawpiece(screen, blocks, &game->nextpiece, 0);
 }
 
 /*
@@ -464,37 +880,70 @@ p_draw(SDL_Surface *screen, SDL_Surface *blocks) {
  *	screen	- screen surface
  *	blocks	- blocks bitmap
  *	piece	- the piece to draw
+ *	fall	- part of a block to draw the piece lower by
  */
 void
-p_drawpiece(SDL_Surface *screen, SDL_Surface *blocks, piece_t *piece) {
-	bd_col_t col;
+p_drawpiece(SDL_Surface *screen, SDL_Surface *blocks, const piece_t *piece, 
+		Uint32 fall) {
+	const p_shape_t *shape;
 
 	assert(screen != NULL && blocks != NULL && piece != NULL);
-	for (int j = 0; j < P_H; j++) {
-		for (int i = 0; i < P_W; i++) {
-			col = p_blocks[piece->col][piece->rot][j][i];
-			if (col != CLEAR) {
-				bd_drawblk(screen, blocks, col, piece->x + i, piece->y + j, 
-						false);
+	shape = &p_set.rots[piece->shape][piece->rot];
+	for (int j = shape->miny; j <= shape->maxy; j++) {
+		for (int i = shape->minx; i <= shape->maxx; i++) {
+			if (P_ROW(shape->mask, j) >> i & 1) {
+				bd_drawblk(screen, blocks, piece->col, piece->x + i, 
+						piece->y + j, fall, false);
 			}
 		}
 	}
 }
 
 /*
- *	Returns a pseudo-random piece colour.  srand should've been called to set 
- *	the initial seed.
+ *	Returns a pseudo-random shape from the game's generator.  With the bag 
+ *	every shape is dealt once, in a random order, before the bag is filled 
+ *	again.
  */
-bd_col_t
-p_randcol(void) {
-	return (bd_col_t) (rand() % (BD_COLS-1)) + 1;
+int
+p_randshape(bloc_game_t *game) {
+	unsigned k;		// Which of the shapes left to take
+	int shape;
+
+	assert(game != NULL);
+	if (!p_set.bag) {
+		return (int) rng_below(&game->rng, p_set.n);
+	}
+	if (game->bag == 0) {
+		game->bag = (p_set.n == 64) ? ~0ULL : (1ULL << p_set.n) - 1;
+	}
+	k = rng_below(&game->rng, p_count(game->bag));
+	for (shape = 0; ; shape++) {
+		if (((game->bag >> shape) & 1) && k-- == 0) {
+			break;
+		}
+	}
+	game->bag &= ~(1ULL << shape);
+	return shape;
 }
 
 /*
- *	Returns a pseudo-random piece rotation.  srand should've been called to 
- *	set the initial seed.
+ *	Returns a pseudo-random piece rotation from the game's generator.
  */
 p_rot_t
-p_randrot(void) {
-	return (p_rot_t) rand() % P_ROTS;
+p_randrot(bloc_game_t *game) {
+	assert(game != NULL);
+	return (p_rot_t) rng_below(&game->rng, P_ROTS);
+}
+
+/*
+ *	Returns the number of shapes in a bag.
+ */
+unsigned
+p_count(Uint64 bag) {
+	unsigned n = 0;
+
+	for ( ; bag != 0; bag &= bag - 1) {
+		n++;
+	}
+	return n;
 }
@@ -1,7 +1,7 @@
 /*
  *	See LICENSE.txt file for copyright and license details.
  *
- *	Requires: <SDL/SDL.h>
+ *	Requires: <stdbool.h>, <SDL/SDL.h>, "bloc.h", "board.h"
  *
  *	Definitions for the current and next game pieces.
  */
@@ -9,17 +9,47 @@
 #ifndef PIECE_H
 #define PIECE_H
 
-#define P_ROTS	4		// Number of rotations
+#define P_ROTS		4		// Number of rotations
+#define P_MAXMOVES	1024	// Most places a piece can land in, for p_genmoves
 
 // Rotations
 typedef enum { NORTH = 0, EAST, SOUTH, WEST } p_rot_t;
 
+// Game piece
+typedef struct {
+	int			shape;	// Shape, from the set of shapes loaded
+	bd_col_t	col;	// Colour
+	p_rot_t		rot;	// Rotation
+	int			x;		// X position, in blocks
+	int			y;		// Y position
+} piece_t;
+
+// Place a game piece can land in
+typedef struct {
+	int			x;		// Position, in blocks
+	int			y;
+	p_rot_t		rot;	// Rotation
+} p_move_t;
+
 // Function prototypes
-extern void p_init(void);
-extern void p_movex(int x);
-extern unsigned p_movey(int y, bool *gameover);
-extern unsigned p_harddrop(bool *gameover, unsigned *dist);
-extern void p_rot(int vel);
-extern void p_draw(SDL_Surface *screen, SDL_Surface *blocks);
+extern void p_loadshapes(const char *name);
+extern void p_usebag(bool bag);
+extern int p_size(void);
+extern void p_init(bloc_game_t *game);
+extern void p_start(bloc_game_t *game, int shape, p_rot_t rot);
+extern void p_setnext(bloc_game_t *game, int shape, p_rot_t rot);
+extern int p_nshapes(void);
+extern Uint32 p_mask(const piece_t *piece);
+extern void p_movex(bloc_game_t *game, int x);
+extern bool p_isresting(const bloc_game_t *game);
+extern void p_lift(bloc_game_t *game, bool *gameover);
+extern unsigned p_movey(bloc_game_t *game, int y, bool *gameover);
+extern unsigned p_harddrop(bloc_game_t *game, bool *gameover, unsigned *dist);
+extern void p_rot(bloc_game_t *game, int vel);
+extern unsigned p_place(bloc_game_t *game, const p_move_t *move, int shape, 
+		p_rot_t rot, bool *gameover);
+extern int p_genmoves(const bloc_game_t *game, p_move_t *moves, int max);
+extern void p_draw(const bloc_game_t *game, SDL_Surface *screen, 
+		SDL_Surface *blocks, Uint32 fall);
 
 #endif // PIECE_H
@@ -0,0 +1,190 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	A small bot to play bloc with --bot, and an example of the other side of
+ *	the protocol in xbot.c.  It tries every rotation of each piece at every
+ *	x, dropped straight down, and places it where it leaves the best board,
+ *	scored on its height, holes, bumps and lines cleared.
+ *
+ *	make refbot
+ *	./bloc --bot ./refbot
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RB_MAXW		64		// Largest board, as in board.h
+#define RB_MAXH		512
+#define RB_MAXSHAPES	64	// Most shapes, as in piece.c
+#define RB_ROTS		4		// Number of rotations
+#define RB_GRID		5		// Size of the grid pieces are drawn in
+#define RB_MAXSTR	(8 + 11 * 21 + RB_MAXH * 17)	// Longest line, see XB_MAXOUT
+#define RB_HEIGHT	-0.51	// Weights for scoring a board
+#define RB_LINES	0.76
+#define RB_HOLES	-0.36
+#define RB_BUMPS	-0.18
+
+// Row j of a piece's mask, as bits
+#define RB_ROW(m, j)	(((m) >> ((j) * RB_GRID)) & ((1UL << RB_GRID) - 1))
+
+typedef unsigned long long rb_row_t;
+
+// Game being played
+static struct {
+	int			w;							// Board size, in blocks
+	int			h;
+	unsigned long	masks[RB_MAXSHAPES][RB_ROTS];	// Blocks of each shape
+	rb_row_t	rows[RB_MAXH];				// Board, top line first
+} rb_game;
+
+// Function prototypes
+static bool rb_fits(const rb_row_t *rows, unsigned long mask, int x, int y);
+static double rb_place(unsigned long mask, int x, int y);
+static void rb_move(int shape, int y);
+
+/*
+ *	Returns true if a piece fits on the board with its grid at x, y.
+ */
+bool
+rb_fits(const rb_row_t *rows, unsigned long mask, int x, int y) {
+	rb_row_t bits;		// Blocks of one row of the piece
+
+	for (int j = 0; j < RB_GRID; j++) {
+		bits = RB_ROW(mask, j);
+		if (bits == 0) {
+			continue;
+		}
+		if (x < 0) {
+			if (bits & ((1UL << -x) - 1)) {
+				return false;
+			}
+			bits >>= -x;
+		} else if ((bits << x) >> x != bits) {
+			return false;
+		} else {
+			bits <<= x;
+		}
+		if (y + j >= rb_game.h 
+		||  (rb_game.w < RB_MAXW && bits >> rb_game.w != 0)) {
+			return false;
+		}
+		if (y + j >= 0 && (rows[y + j] & bits)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ *	Returns the score of the board left by dropping a piece from x, y, or
+ *	a very low score if it doesn't fit there.
+ */
+double
+rb_place(unsigned long mask, int x, int y) {
+	rb_row_t rows[RB_MAXH];		// Board after the drop
+	rb_row_t full;				// Row with no gaps
+	rb_row_t bits;
+	int top[RB_MAXW];			// Height of each column
+	int lines = 0, height = 0, holes = 0, bumps = 0;
+	int n = 0;					// Lines left
+
+	if (!rb_fits(rb_game.rows, mask, x, y)) {
+		return -1e9;
+	}
+	while (rb_fits(rb_game.rows, mask, x, y + 1)) {
+		y++;
+	}
+	memcpy(rows, rb_game.rows, rb_game.h * sizeof(rows[0]));
+	for (int j = 0; j < RB_GRID; j++) {
+		bits = RB_ROW(mask, j);
+		bits = (x < 0) ? bits >> -x : bits << x;
+		if (bits != 0 && y + j >= 0) {
+			rows[y + j] |= bits;
+		}
+	}
+	full = (rb_game.w == RB_MAXW) ? ~0ULL : (1ULL << rb_game.w) - 1;
+	for (int j = rb_game.h - 1; j >= 0; j--) {
+		if (rows[j] == full) {
+			lines++;
+		} else {
+			rows[rb_game.h - 1 - n++] = rows[j];
+		}
+	}
+	for (int j = rb_game.h - 1 - n; j >= 0; j--) {
+		rows[j] = 0;
+	}
+	for (int i = 0; i < rb_game.w; i++) {
+		top[i] = 0;
+		for (int j = 0; j < rb_game.h; j++) {
+			if (rows[j] >> i & 1) {
+				if (top[i] == 0) {
+					top[i] = rb_game.h - j;
+				}
+			} else if (top[i] != 0) {
+				holes++;
+			}
+		}
+		height += top[i];
+		if (i > 0) {
+			bumps += abs(top[i] - top[i-1]);
+		}
+	}
+	return RB_HEIGHT * height + RB_LINES * lines + RB_HOLES * holes
+		+ RB_BUMPS * bumps;
+}
+
+/*
+ *	Answer with the best place for the piece.
+ *	y	- where the piece's grid is
+ */
+void
+rb_move(int shape, int y) {
+	double score, best = -2e9;
+	int bestx = 0, bestrot = 0;
+
+	for (int r = 0; r < RB_ROTS; r++) {
+		for (int x = -RB_GRID; x < rb_game.w; x++) {
+			score = rb_place(rb_game.masks[shape][r], x, y);
+			if (score > best) {
+				best = score;
+				bestx = x;
+				bestrot = r;
+			}
+		}
+	}
+	printf("place %d %d\n", bestx, bestrot);
+	fflush(stdout);
+}
+
+/*
+ *	Main.  Reads lines from the game till it closes the pipe.
+ */
+int
+main(void) {
+	static char s[RB_MAXSTR];	// Line from the game
+	unsigned long m[RB_ROTS];	// Masks of a shape
+	int shape, y, n;			// Fields of a line
+	char *p;					// Rest of the line
+
+	while (fgets(s, RB_MAXSTR, stdin) != NULL) {
+		if (sscanf(s, "game %d %d", &rb_game.w, &rb_game.h) == 2) {
+			if (rb_game.w > RB_MAXW || rb_game.h > RB_MAXH) {
+				return EXIT_FAILURE;
+			}
+		} else if (sscanf(s, "shape %d %lx %lx %lx %lx", &shape, &m[0], &m[1],
+				&m[2], &m[3]) == 5 && shape >= 0 && shape < RB_MAXSHAPES) {
+			memcpy(rb_game.masks[shape], m, sizeof(m));
+		} else if (sscanf(s, "piece %*u %*u %*u %*u %*d %d %*d %*d %d %*d %*d"
+				"%n", &shape, &y, &n) == 2 && shape >= 0
+				&& shape < RB_MAXSHAPES) {
+			p = s + n;
+			for (int j = 0; j < rb_game.h; j++) {
+				rb_game.rows[j] = strtoull(p, &p, 16);
+			}
+			rb_move(shape, y);
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,211 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Code for recording games and reading them back.  A game is recorded as
+ *	the settings and seed it started with and the keys applied to it, each
+ *	stamped with the game time it was applied at.  The game is run on a
+ *	fixed step, so applying the same keys at the same game times plays it
+ *	back exactly.  Games are saved one after the other in a text file:
+ *
+ *	game seed width height rate gravity bag shapes
+ *	key time key down
+ *	...
+ *	end ticks over score hash
+ *
+ *	Times are in parts of a tick, keys are the numbers of g_key_t, bag, down
+ *	and over are 0 or 1 and shapes is - for Tetriminos.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+#include "bloc.h"
+#include "board.h"
+#include "piece.h"
+#include "rng.h"
+#include "score.h"
+#include "game.h"
+#include "replay.h"
+
+#define RP_MAXSTR		(RP_MAXNAME + 128)	// Longest line in a file
+#define RP_READONLY		"r"					// Open file to read
+#define RP_APPEND		"a"					// Open file to add to
+#define RP_NOSHAPES		"-"					// Shapes name for Tetriminos
+#define RP_MINKEYS		256					// Room for keys to start with
+
+/*
+ *	Start recording a game.  The room for keys from an earlier recording is
+ *	reused.
+ */
+void
+rp_start(rp_game_t *rec, const rp_setup_t *setup) {
+	assert(rec != NULL && setup != NULL);
+	rec->setup = *setup;
+	rec->nkeys = 0;
+	rec->ticks = 0;
+	rec->over = false;
+	rec->score = 0;
+	rec->hash = 0;
+}
+
+/*
+ *	Add a key to the recording, just before it is applied.
+ */
+void
+rp_add(rp_game_t *rec, const g_event_t *ev) {
+	g_event_t *keys;
+
+	assert(rec != NULL && ev != NULL);
+	if (rec->nkeys == rec->maxkeys) {
+		rec->maxkeys = (rec->maxkeys == 0) ? RP_MINKEYS : rec->maxkeys * 2;
+		keys = realloc(rec->keys, rec->maxkeys * sizeof(*keys));
+		if (keys == NULL) {
+			b_error("Error: out of memory for recording\n");
+		}
+		rec->keys = keys;
+	}
+	rec->keys[rec->nkeys++] = *ev;
+}
+
+/*
+ *	Finish recording a game.
+ *	over	- true if the game ended by game over rather than quitting
+ */
+void
+rp_end(rp_game_t *rec, const bloc_game_t *game, bool over) {
+	assert(rec != NULL && game != NULL);
+	rec->ticks = game->time / G_TICKPART;
+	rec->over = over;
+	rec->score = s_get(game);
+	rec->hash = game->hash;
+}
+
+/*
+ *	Returns true if a game played back from a recording ended the same way,
+ *	with the same score, board and pieces.
+ *	over	- true if the game played back ended by game over
+ */
+bool
+rp_check(const rp_game_t *rec, const bloc_game_t *game, bool over) {
+	assert(rec != NULL && game != NULL);
+	return over == rec->over && game->time == rec->ticks * G_TICKPART
+		&& s_get(game) == rec->score && game->hash == rec->hash;
+}
+
+/*
+ *	Add a recorded game to the end of the file.
+ */
+void
+rp_save(const rp_game_t *rec, const char *file) {
+	FILE *fp;		// Replay file
+
+	assert(rec != NULL && file != NULL);
+	fp = fopen(file, RP_APPEND);
+	if (fp == NULL) {
+		fprintf(stderr, "Error opening replay file %s for writing\n", file);
+		return;
+	}
+	fprintf(fp, "game %llu %d %d %u %.17g %d %s\n",
+			(unsigned long long) rec->setup.seed, rec->setup.w, rec->setup.h,
+			rec->setup.rate, rec->setup.gravity, rec->setup.bag,
+			(rec->setup.shapes[0] == '\0') ? RP_NOSHAPES : rec->setup.shapes);
+	for (unsigned i = 0; i < rec->nkeys; i++) {
+		fprintf(fp, "key %llu %d %d\n", (unsigned long long) rec->keys[i].time,
+				rec->keys[i].key, rec->keys[i].down);
+	}
+	fprintf(fp, "end %llu %d %lu %llx\n", (unsigned long long) rec->ticks,
+			rec->over, rec->score, (unsigned long long) rec->hash);
+	if (ferror(fp)) {
+		fprintf(stderr, "Error writing replay file %s\n", file);
+	}
+	if (fclose(fp) == EOF) {
+		fprintf(stderr, "Error closing replay file %s\n", file);
+	}
+}
+
+/*
+ *	Open a replay file to read the games from.  Exits if it can't be opened.
+ */
+FILE *
+rp_open(const char *file) {
+	FILE *fp;		// Replay file
+
+	assert(file != NULL);
+	fp = fopen(file, RP_READONLY);
+	if (fp == NULL) {
+		b_error("Error opening replay file %s\n", file);
+	}
+	return fp;
+}
+
+/*
+ *	Read the next game from a replay file.  Returns false if there are no
+ *	more games, exits if the file isn't a replay file.
+ *	file	- name of the file, for errors
+ */
+bool
+rp_load(FILE *fp, const char *file, rp_game_t *rec) {
+	char s[RP_MAXSTR];			// Line from the file
+	unsigned long long a, b;	// Numbers read from the line
+	int key, down, bag;
+	int n;						// Length of what was read
+	rp_setup_t setup;
+	g_event_t ev;
+
+	assert(fp != NULL && file != NULL && rec != NULL);
+	if (fgets(s, RP_MAXSTR, fp) == NULL) {
+		if (ferror(fp)) {
+			b_error("Error reading replay file %s\n", file);
+		}
+		return false;
+	}
+	if (sscanf(s, "game %llu %d %d %u %lf %d %n", &a, &setup.w, &setup.h,
+			&setup.rate, &setup.gravity, &bag, &n) < 6
+	||  setup.w < BD_MINW || setup.w > BD_MAXW
+	||  setup.h < BD_MINH || setup.h > BD_MAXH || setup.rate == 0) {
+		b_error("Error: %s is not a replay file\n", file);
+	}
+	setup.seed = a;
+	setup.bag = (bag != 0);
+	s[strcspn(s, "\r\n")] = '\0';
+	if (strcmp(s + n, RP_NOSHAPES) == 0) {
+		setup.shapes[0] = '\0';
+	} else {
+		strncpy(setup.shapes, s + n, RP_MAXNAME - 1);
+		setup.shapes[RP_MAXNAME-1] = '\0';
+	}
+	rp_start(rec, &setup);
+	while (fgets(s, RP_MAXSTR, fp) != NULL) {
+		if (sscanf(s, "key %llu %d %d", &a, &key, &down) == 3
+		&&  key >= G_LEFT && key <= G_HARD) {
+			ev.time = a;
+			ev.key = (g_key_t) key;
+			ev.down = (down != 0);
+			rp_add(rec, &ev);
+		} else if (sscanf(s, "end %llu %d %lu %llx", &a, &down, &rec->score,
+				&b) == 4) {
+			rec->ticks = a;
+			rec->over = (down != 0);
+			rec->hash = b;
+			return true;
+		} else {
+			break;
+		}
+	}
+	b_error("Error: game in replay file %s is not complete\n", file);
+	return false;
+}
+
+/*
+ *	Free the room for keys.
+ */
+void
+rp_free(rp_game_t *rec) {
+	assert(rec != NULL);
+	free(rec->keys);
+	rec->keys = NULL;
+	rec->nkeys = rec->maxkeys = 0;
+}
@@ -0,0 +1,53 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <stdbool.h>, <stdio.h>, <SDL/SDL.h>, "bloc.h", "score.h",
+ *	"game.h"
+ *
+ *	Definitions for recording games and reading them back.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#define RP_MAXNAME	256		// Longest shapes name, including \0
+
+// Settings a game was started with, it only plays back the same with them
+typedef struct {
+	Uint64		seed;				// Seed for the game's pieces
+	int			w;					// Board size, in blocks
+	int			h;
+	unsigned	rate;				// Game ticks per second
+	double		gravity;			// Fixed gravity, 0 for levels
+	bool		bag;				// Shapes dealt from a bag
+	char		shapes[RP_MAXNAME];	// Shape set or file, "" for Tetriminos
+} rp_setup_t;
+
+/*
+ *	A recorded game, the settings it started with and every key applied to
+ *	it, in order, stamped with the game time it was applied at.  How the
+ *	game ended is kept so a replay can be checked against it.
+ */
+typedef struct {
+	rp_setup_t	setup;
+	g_event_t	*keys;		// Keys applied
+	unsigned	nkeys;		// Number of keys
+	unsigned	maxkeys;	// Room for keys
+	Uint64		ticks;		// Ticks run
+	bool		over;		// Ended by game over rather than quitting
+	score_t		score;		// Final score
+	Uint64		hash;		// Final hash of the board and pieces
+} rp_game_t;
+
+// Function prototypes
+extern void rp_start(rp_game_t *rec, const rp_setup_t *setup);
+extern void rp_add(rp_game_t *rec, const g_event_t *ev);
+extern void rp_end(rp_game_t *rec, const bloc_game_t *game, bool over);
+extern bool rp_check(const rp_game_t *rec, const bloc_game_t *game,
+		bool over);
+extern void rp_save(const rp_game_t *rec, const char *file);
+extern FILE *rp_open(const char *file);
+extern bool rp_load(FILE *fp, const char *file, rp_game_t *rec);
+extern void rp_free(rp_game_t *rec);
+
+#endif // REPLAY_H
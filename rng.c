@@ -0,0 +1,62 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Code for the pseudo-random number generator, xoshiro256** by David 
+ *	Blackman and Sebastiano Vigna.  The state is kept by the caller so games 
+ *	can be replayed from their seed and run on several threads at once.
+ */
+
+#include <assert.h>
+#include "SDL.h"
+#include "rng.h"
+
+// Rotate x left by k bits
+#define RNG_ROTL(x, k)	(((x) << (k)) | ((x) >> (64 - (k))))
+
+/*
+ *	Set the generator's state from a seed.  The state is filled using 
+ *	splitmix64, so any seed, even zero, gives a good state.
+ */
+void
+rng_seed(rng_t *rng, Uint64 seed) {
+	Uint64 z;
+
+	assert(rng != NULL);
+	for (int i = 0; i < 4; i++) {
+		seed += 0x9E3779B97F4A7C15ULL;
+		z = seed;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		rng->s[i] = z ^ (z >> 31);
+	}
+}
+
+/*
+ *	Returns the next 64 pseudo-random bits.
+ */
+Uint64
+rng_next(rng_t *rng) {
+	Uint64 result, t;
+
+	assert(rng != NULL);
+	result = RNG_ROTL(rng->s[1] * 5, 7) * 9;
+	t = rng->s[1] << 17;
+	rng->s[2] ^= rng->s[0];
+	rng->s[3] ^= rng->s[1];
+	rng->s[1] ^= rng->s[2];
+	rng->s[0] ^= rng->s[3];
+	rng->s[2] ^= t;
+	rng->s[3] = RNG_ROTL(rng->s[3], 45);
+	return result;
+}
+
+/*
+ *	Returns a pseudo-random number from 0 to n - 1.  The top 32 bits are 
+ *	scaled to the range with a multiply rather than a divide, the bias is 
+ *	too small to matter for the small ranges used.
+ */
+unsigned
+rng_below(rng_t *rng, unsigned n) {
+	assert(rng != NULL && n > 0);
+	return (unsigned) (((rng_next(rng) >> 32) * n) >> 32);
+}
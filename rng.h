@@ -0,0 +1,22 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <SDL/SDL.h>
+ *
+ *	Definitions for the pseudo-random number generator.
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+// Generator state, xoshiro256**, each game has its own
+typedef struct {
+	Uint64	s[4];
+} rng_t;
+
+// Function prototypes
+extern void rng_seed(rng_t *rng, Uint64 seed);
+extern Uint64 rng_next(rng_t *rng);
+extern unsigned rng_below(rng_t *rng, unsigned n);
+
+#endif // RNG_H
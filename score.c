@@ -14,9 +14,13 @@
 #include "SDL.h"
 #include "bloc.h"
 #include "bmpfont.h"
+#include "board.h"
+#include "piece.h"
+#include "rng.h"
 #include "score.h"
+#include "game.h"
 
-#define S_NUMAWARDS	5				// Number of possible basic awards + 1
+#define S_NUMAWARDS	6				// Number of possible basic awards + 1
 #define S_FILE		"scores.txt"	// High scores save file
 #define S_READONLY	"r"				// Open file read only
 #define S_WRITEONLY	"w"				// Open file to write
@@ -26,7 +30,6 @@
 #define S_HIGHSPC	24				// Amount of space between high scores
 #define S_HIGHX		0				// High score offset
 #define S_HIGHY		(B_GAMEH-S_NUMHIGH*BF_FONTH-(S_NUMHIGH-1)*S_HIGHSPC)/2
-#define S_TICKLEN	20				// Tick length in ms when entering name
 
 // High score
 typedef struct {
@@ -35,19 +38,18 @@ typedef struct {
 } high_t;
 
 /*
- *	Basic award given for the number of lines cleared at the same time.
+ *	Basic award given for the number of lines cleared at the same time.  
+ *	Shapes are at most 5 blocks tall, so a piece can clear 5 lines.
  */
 static const score_t s_awards[S_NUMAWARDS] = {
 	0,		// Unused
 	100,	// 1 line
 	300,	// 2 lines
 	600,	// 3 lines
-	1000	// Tetris!
+	1000,	// Tetris!
+	1500	// 5 lines, only with pentominoes or loaded shapes
 };
 
-// The score for this game
-static score_t score = 0;
-
 // High scores table
 static high_t s_high[S_NUMHIGH];
 
@@ -67,104 +69,77 @@ static const high_t s_defaults[S_NUMHIGH] = {
 };
 
 // Function prototypes
-static bool s_keys(bool *done, char *name, unsigned *len, unsigned maxname);
 static void s_print(SDL_Surface *screen, SDL_Surface *font, int x, int y);
 
 /*
- *	Ask player to enter name.  We can get typed text by simply using Unicode 
- *	translation in SDL.  Returns true if exiting the game.
+ *	Draw the box asking the player to enter their name.
  *	screen	- screen surface
  *	font	- font bitmap
  *	bg		- message box background
- *	name	- entered player's name, storage must already be allocated
- *	maxname	- maximum player's name length + 1 for \0
+ *	name	- player's name entered so far
  */
-bool
-s_entername(SDL_Surface *screen, SDL_Surface *font, SDL_Surface *bg, 
-		char *name, unsigned maxname) {
-	bool		done	= false;	// Finished entering name if set to true
-	bool		exit	= false;	// Exiting program
-	unsigned	n		= 0;		// Length of name entered
-	Uint32		nexttick;			// Time, in ms, of next tick
-
+void
+s_drawname(SDL_Surface *screen, SDL_Surface *font, SDL_Surface *bg, 
+		const char *name) {
 	assert(screen != NULL && font != NULL && bg != NULL && name != NULL);
-	name[n] = '\0';
-	SDL_EnableUNICODE(1);
-	nexttick = SDL_GetTicks() + S_TICKLEN;
-	do {
-		bf_msgbox(screen, font, bg, BF_LEFT, "Enter name: %s", name);
-		b_update(screen);
-		exit = s_keys(&done, name, &n, maxname);
-		SDL_Delay(b_delaylen(nexttick));
-		nexttick += S_TICKLEN;
-	} while (!done);
-	SDL_EnableUNICODE(0);
-	return exit;
+	bf_msgbox(screen, font, bg, BF_LEFT, "Enter name: %s", name);
+	b_update(screen);
 }
 
 /*
- *	Handle keyboard input for entering player name.  To keep things simple 
- *	we stick to printable ASCII values.  The translated Unicode is simply 
- *	converted into a char value if it's in the range we want.  Backspace is 
- *	supported.  Returns true if exiting the game.
+ *	Handle a key for entering the player's name.  We can get typed text by 
+ *	simply using Unicode translation in SDL, which must be enabled while the 
+ *	name is entered.  To keep things simple we stick to printable ASCII 
+ *	values.  The translated Unicode is simply converted into a char value if 
+ *	it's in the range we want.  Backspace is supported.  Returns true once 
+ *	the name is finished.
  *	name	- entered player's name, storage must already be allocated
  *	len		- current length of name
- *	maxname	- maximum player's name length + 1 for \0
+ *	maxname	- maximum player's name length, storage is one more for \0
  */
 bool
-s_keys(bool *done, char *name, unsigned *len, unsigned maxname) {
-	SDL_Event	event;
-	bool exit = false;	// Set to true if we're exiting the game
+s_keyname(const SDL_Event *event, char *name, unsigned *len, unsigned maxname) {
+	bool done = false;	// Finished entering name if set to true
 
-	assert(done != NULL && name != NULL && len != NULL);
-	while (SDL_PollEvent(&event)) {
-		switch (event.type) {
-			case SDL_KEYDOWN:
-				switch (event.key.keysym.sym) {
-					case SDLK_BACKSPACE:
-						if (*len > 0) {
-							name[--(*len)] = '\0';
-						}
-						break;
-					case SDLK_ESCAPE:
-					case SDLK_RETURN:
-						*done = true;
-						break;
-					default:
-						if (*len < maxname
-								&& event.key.keysym.unicode >= BF_ASCMIN
-								&& event.key.keysym.unicode <= BF_ASCMAX) {
-							name[(*len)++] = (char) event.key.keysym.unicode;
-							name[*len] = '\0';
-						}
-						break;
-				}
-				break;
-			case SDL_QUIT:
-				*done = exit = true;
-				break;
-			default:
-				// VOID
-				break;
-		}
+	assert(event != NULL && name != NULL && len != NULL);
+	if (event->type != SDL_KEYDOWN) {
+		return false;
 	}
-	return exit;
+	switch (event->key.keysym.sym) {
+		case SDLK_BACKSPACE:
+			if (*len > 0) {
+				name[--(*len)] = '\0';
+			}
+			break;
+		case SDLK_ESCAPE:
+		case SDLK_RETURN:
+			done = true;
+			break;
+		default:
+			if (*len < maxname
+					&& event->key.keysym.unicode >= BF_ASCMIN
+					&& event->key.keysym.unicode <= BF_ASCMAX) {
+				name[(*len)++] = (char) event->key.keysym.unicode;
+				name[*len] = '\0';
+			}
+			break;
+	}
+	return done;
 }
 
 /*
- *	Display the high scores and wait for key.
+ *	Draw the high scores.
  *	screen	- screen surface
  *	font	- font bitmap
  *	bg		- scores background
  */
-bool
+void
 s_display(SDL_Surface *screen, SDL_Surface *font, SDL_Surface *bg, int x,
 		int y) {
 	assert(screen != NULL && font != NULL && bg != NULL);
 	b_drawbg(screen, bg);
 	s_print(screen, font, x + S_HIGHX, y + S_HIGHY);
 	b_update(screen);
-	return b_waitkey(B_ANYKEY);
 }
 
 /*
@@ -283,17 +258,21 @@ s_print(SDL_Surface *screen, SDL_Surface *font, int x, int y) {
 
 /*
  *	Award score, based on the number of lines cleared, the level and the 
- *	distance dropped, in the case of a hard drop.
+ *	distance dropped, in the case of a hard drop.  The lines are added to 
+ *	the game's count of lines cleared.
  */
 void
-s_award(unsigned lines, unsigned level, unsigned dist, unsigned maxdist) {
+s_award(bloc_game_t *game, unsigned lines, unsigned level, unsigned dist, 
+		unsigned maxdist) {
 	score_t award;		// Basic award
 	score_t bonus;		// Hard drop bonus
 
+	assert(game != NULL);
 	assert(lines < S_NUMAWARDS && dist <= maxdist && maxdist > 0);
 	award = s_awards[lines];
 	bonus = (score_t) ((double) dist / (double) maxdist * (double) award);
-	score += level * (bonus + award);
+	game->score += level * (bonus + award);
+	game->lines += lines;
 }
 
 /*
@@ -306,11 +285,13 @@ s_ishigh(score_t score) {
 }
 
 /*
- *	Initialise the current game's score.
+ *	Initialise the current game's score and lines cleared.
  */
 void
-s_init(void) {
-	score = 0;
+s_init(bloc_game_t *game) {
+	assert(game != NULL);
+	game->score = 0;
+	game->lines = 0;
 }
 
 /*
@@ -327,6 +308,7 @@ s_cleanup(void) {
  *	Return the current game's score.
  */
 score_t
-s_get(void) {
-	return score;
+s_get(const bloc_game_t *game) {
+	assert(game != NULL);
+	return game->score;
 }
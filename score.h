@@ -1,7 +1,7 @@
 /*
  *	See LICENSE.txt file for copyright and license details.
  *
- *	Requirements: <stdbool.h>, <SDL/SDL.h>
+ *	Requirements: <stdbool.h>, <SDL/SDL.h>, "bloc.h"
  */
 
 #ifndef SCORE_H
@@ -13,18 +13,20 @@
 typedef unsigned long score_t;
 
 // Function prototypes
-extern bool s_entername(SDL_Surface *screen, SDL_Surface *font, 
-		SDL_Surface *bg, char *name, unsigned maxname);
-extern bool s_display(SDL_Surface *screen, SDL_Surface *font, SDL_Surface *bg, 
+extern void s_drawname(SDL_Surface *screen, SDL_Surface *font, 
+		SDL_Surface *bg, const char *name);
+extern bool s_keyname(const SDL_Event *event, char *name, unsigned *len, 
+		unsigned maxname);
+extern void s_display(SDL_Surface *screen, SDL_Surface *font, SDL_Surface *bg, 
 		int x, int y);
 extern void s_load(void);
 extern void s_save(void);
 extern void s_newhigh(score_t score, const char *name);
-extern void s_award(unsigned lines, unsigned level, unsigned dist, 
-		unsigned maxdist);
+extern void s_award(bloc_game_t *game, unsigned lines, unsigned level, 
+		unsigned dist, unsigned maxdist);
 extern bool s_ishigh(score_t score);
-extern void s_init(void);
+extern void s_init(bloc_game_t *game);
 extern void s_cleanup(void);
-extern score_t s_get(void);
+extern score_t s_get(const bloc_game_t *game);
 
 #endif // SCORE_H
@@ -0,0 +1,204 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Code for sharing the game's state with other processes, such as
+ *	overlays, analysers and bots, through a file mapped into memory.  A file
+ *	on a memory file system, e.g. /dev/shm on Linux, is never written to
+ *	disk.  The game writes the state as it runs under a sequence lock, see
+ *	sh_state_t, so readers never hold the game up and see every state whole.
+ *	Only POSIX is supported.
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE	200112L
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "SDL.h"
+#include "bloc.h"
+#include "board.h"
+#include "piece.h"
+#include "rng.h"
+#include "score.h"
+#include "game.h"
+#include "share.h"
+
+#define SH_MODE		0644	// Permissions the file is made with
+
+#ifndef _WIN32
+// Shared state, NULL if not shared
+static sh_state_t *sh_state = NULL;
+
+// Function prototypes
+static Uint32 sh_begin(void);
+static void sh_end(Uint32 seq);
+static void sh_putpiece(sh_piece_t *to, const piece_t *piece);
+
+/*
+ *	Share the game's state through a file, made if it doesn't exist.  A
+ *	file left by an earlier game is reused, its sequence carries on so
+ *	readers still mapping it aren't confused.  Exits if it can't be mapped.
+ */
+void
+sh_open(const char *file) {
+	void *map;
+	Uint32 seq;
+	int fd;
+
+	assert(file != NULL);
+	fd = open(file, O_RDWR | O_CREAT, SH_MODE);
+	if (fd == -1) {
+		b_error("Error opening shared state file %s: %s\n", file,
+				strerror(errno));
+	}
+	if (ftruncate(fd, sizeof(sh_state_t)) == -1) {
+		b_error("Error sizing shared state file %s: %s\n", file,
+				strerror(errno));
+	}
+	map = mmap(NULL, sizeof(sh_state_t), PROT_READ | PROT_WRITE, MAP_SHARED,
+			fd, 0);
+	if (map == MAP_FAILED) {
+		b_error("Error mapping shared state file %s: %s\n", file,
+				strerror(errno));
+	}
+	close(fd);
+	sh_state = map;
+	seq = sh_begin();
+	memset((Uint8 *) sh_state + offsetof(sh_state_t, rate), 0,
+			sizeof(sh_state_t) - offsetof(sh_state_t, rate));
+	sh_state->magic = SH_MAGIC;
+	sh_state->version = SH_VERSION;
+	sh_end(seq);
+}
+
+/*
+ *	Write the game's state, if it is shared, from the thread running the
+ *	game.  Only the lines of the board are written, a few words each.
+ *	over	- true once the game is over
+ */
+void
+sh_write(const bloc_game_t *game, bool over) {
+	const bd_board_t *brd;
+	sh_state_t *s;
+	Uint32 seq;
+	int r;			// Where the line is stored
+
+	assert(game != NULL);
+	if (sh_state == NULL) {
+		return;
+	}
+	s = sh_state;
+	brd = &game->board;
+	seq = sh_begin();
+	s->rate = game->rate;
+	s->tick = game->time / G_TICKPART;
+	s->score = s_get(game);
+	s->hash = game->hash;
+	s->lines = game->lines;
+	s->level = G_LEV(game->grav.diff);
+	s->over = over;
+	s->w = (Uint16) brd->w;
+	s->h = (Uint16) brd->h;
+	sh_putpiece(&s->piece, &game->piece);
+	sh_putpiece(&s->next, &game->nextpiece);
+	for (int j = 0; j < brd->h; j++) {
+		r = brd->map[j];
+		s->rows[j] = brd->rows[r];
+		for (int k = 0; k < BD_COLBITS; k++) {
+			s->colplane[j][k] = brd->colplane[r][k];
+		}
+	}
+	sh_end(seq);
+}
+
+/*
+ *	Stop sharing the game's state, the file is left with the last state
+ *	written.
+ */
+void
+sh_close(void) {
+	if (sh_state != NULL) {
+		munmap(sh_state, sizeof(sh_state_t));
+		sh_state = NULL;
+	}
+}
+
+/*
+ *	Start writing the shared state, seq is made odd before anything else is
+ *	written.  Returns the sequence before.
+ */
+Uint32
+sh_begin(void) {
+	Uint32 seq;
+
+	seq = sh_state->seq & ~1U;
+	B_STORE(&sh_state->seq, seq + 1);
+	B_FENCE();
+	return seq;
+}
+
+/*
+ *	Finish writing the shared state, seq is made even after everything else
+ *	is written.
+ *	seq	- sequence from sh_begin
+ */
+void
+sh_end(Uint32 seq) {
+	B_STORE(&sh_state->seq, seq + 2);
+}
+
+/*
+ *	Write a piece into the shared state.
+ */
+void
+sh_putpiece(sh_piece_t *to, const piece_t *piece) {
+	assert(to != NULL && piece != NULL);
+	to->mask = p_mask(piece);
+	to->x = (Sint16) piece->x;
+	to->y = (Sint16) piece->y;
+	to->shape = (Uint8) piece->shape;
+	to->col = (Uint8) piece->col;
+	to->rot = (Uint8) piece->rot;
+}
+
+#else // _WIN32
+
+/*
+ *	Sharing the game's state isn't supported.
+ */
+void
+sh_open(const char *file) {
+	(void) file;
+	b_error("Error: sharing the game's state isn't supported on Windows\n");
+}
+
+/*
+ *	The state is never shared.
+ */
+void
+sh_write(const bloc_game_t *game, bool over) {
+	(void) game;
+	(void) over;
+}
+
+/*
+ *	The state is never shared.
+ */
+void
+sh_close(void) {
+	// VOID
+}
+
+#endif // _WIN32
@@ -0,0 +1,67 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <stdbool.h>, <SDL/SDL.h>, "bloc.h", "board.h"
+ *
+ *	Definitions for the game state shared with other processes.
+ */
+
+#ifndef SHARE_H
+#define SHARE_H
+
+#define SH_MAGIC	0x636F6C62U	// "bloc", first word of the shared state
+#define SH_VERSION	1			// Layout of the shared state
+#define SH_PIECEW	5			// Width of the grid a piece's mask is in
+
+// A piece in the shared state
+typedef struct {
+	Uint32	mask;		// Blocks, bit i + j * SH_PIECEW for column i of row j
+	Sint16	x;			// Position of the grid on the board, in blocks
+	Sint16	y;
+	Uint8	shape;		// Shape, from the set of shapes loaded
+	Uint8	col;		// Colour
+	Uint8	rot;		// Rotation
+	Uint8	unused;
+} sh_piece_t;
+
+/*
+ *	Game state shared with other processes through a file mapped into
+ *	memory, written by the game under a sequence lock.  seq is odd while the
+ *	state is being written and goes up by 2 each time it is.  A reader maps
+ *	the file read only and, without ever holding the game up:
+ *
+ *	do {
+ *		s1 = seq, with acquire
+ *		read what it wants, straight from the map
+ *		acquire fence
+ *		s2 = seq
+ *	} while (s1 is odd || s1 != s2)
+ *
+ *	Lines are in board order, from the top, bit x of a row is column x.
+ *	Plane k of a line holds bit k of the colour of each block in it.
+ */
+typedef struct {
+	Uint32		magic;							// SH_MAGIC
+	Uint32		version;						// SH_VERSION
+	Uint32		seq;							// Sequence lock
+	Uint32		rate;							// Game ticks per second
+	Uint64		tick;							// Ticks the game has run
+	Uint64		score;
+	Uint64		hash;							// Hash of the board and pieces
+	Uint32		lines;							// Lines cleared
+	Uint32		level;
+	Uint32		over;							// 1 once the game is over
+	Uint16		w;								// Board size, in blocks
+	Uint16		h;
+	sh_piece_t	piece;							// The main game piece
+	sh_piece_t	next;							// The next game piece
+	Uint64		rows[BD_MAXH];					// Occupied blocks
+	Uint64		colplane[BD_MAXH][BD_COLBITS];	// Colours of the blocks
+} sh_state_t;
+
+// Function prototypes
+extern void sh_open(const char *file);
+extern void sh_write(const bloc_game_t *game, bool over);
+extern void sh_close(void);
+
+#endif // SHARE_H
@@ -0,0 +1,75 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Code for the Zobrist hash keys and the transposition table.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include "SDL.h"
+#include "tt.h"
+
+#define TT_GOLDEN	0x9E3779B97F4A7C15ULL	// Weyl sequence step of splitmix64
+
+// Read and write a word of an entry atomically, no ordering is needed
+#define TT_LOAD(p)		__atomic_load_n((p), __ATOMIC_RELAXED)
+#define TT_STORE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELAXED)
+
+/*
+ *	Returns the Zobrist key for n, the n-th output of splitmix64.  Keys are 
+ *	worked out when needed so there is no table of keys to set up or keep 
+ *	in cache, and the same n always gives the same key.
+ */
+Uint64
+tt_key(Uint64 n) {
+	Uint64 z = (n + 1) * TT_GOLDEN;
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/*
+ *	Empty the table.
+ */
+void
+tt_clear(tt_table_t *tt) {
+	assert(tt != NULL);
+	for (int i = 0; i < TT_SIZE; i++) {
+		TT_STORE(&tt->entries[i].check, 0);
+		TT_STORE(&tt->entries[i].data, 0);
+	}
+}
+
+/*
+ *	Look up a position.  Returns true, setting data to what was stored for 
+ *	it, if the position is in the table.
+ */
+bool
+tt_probe(const tt_table_t *tt, Uint64 hash, Uint64 *data) {
+	const tt_entry_t *entry;
+	Uint64 check, d;
+
+	assert(tt != NULL && data != NULL);
+	entry = &tt->entries[hash & (TT_SIZE - 1)];
+	check = TT_LOAD(&entry->check);
+	d = TT_LOAD(&entry->data);
+	if ((check ^ d) != hash) {
+		return false;
+	}
+	*data = d;
+	return true;
+}
+
+/*
+ *	Store data for a position, replacing whatever was in its entry.
+ */
+void
+tt_store(tt_table_t *tt, Uint64 hash, Uint64 data) {
+	tt_entry_t *entry;
+
+	assert(tt != NULL);
+	entry = &tt->entries[hash & (TT_SIZE - 1)];
+	TT_STORE(&entry->check, hash ^ data);
+	TT_STORE(&entry->data, data);
+}
@@ -0,0 +1,37 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <stdbool.h>, <SDL/SDL.h>
+ *
+ *	Definitions for hash keys and the transposition table.
+ */
+
+#ifndef TT_H
+#define TT_H
+
+#define TT_BITS		16					// Size of the table, as a power of 2
+#define TT_SIZE		(1 << TT_BITS)		// Number of entries in the table
+
+// Entry in the table, check is the position's hash XORed with data
+typedef struct {
+	Uint64	check;
+	Uint64	data;
+} tt_entry_t;
+
+/*
+ *	Transposition table, a fixed number of entries indexed by the low bits 
+ *	of a position's hash.  Entries are read and written without locks by 
+ *	any number of threads.  A torn entry, one word from one store and one 
+ *	from another, fails the check and is treated as missing.
+ */
+typedef struct {
+	tt_entry_t	entries[TT_SIZE];
+} tt_table_t;
+
+// Function prototypes
+extern Uint64 tt_key(Uint64 n);
+extern void tt_clear(tt_table_t *tt);
+extern bool tt_probe(const tt_table_t *tt, Uint64 hash, Uint64 *data);
+extern void tt_store(tt_table_t *tt, Uint64 hash, Uint64 data);
+
+#endif // TT_H
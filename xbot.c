@@ -0,0 +1,418 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Code for letting another program play the game.  The bot is run with
+ *	its standard input and output joined to the game by pipes and the two
+ *	talk in lines of text.  The game sends:
+ *
+ *	game width height shapes
+ *	shape n mask mask mask mask
+ *	...
+ *	piece n tick score lines level shape rot x y next nextrot row ... row
+ *	...
+ *	end ticks over score
+ *
+ *	game starts each game and is followed by a shape line for each shape,
+ *	with its blocks in each rotation as a hex mask, bit i + j * 5 for column
+ *	i of row j of the grid the piece is drawn in.  A piece line is sent as
+ *	each piece comes on to the board, once any full lines have gone or, in
+ *	the window, sooner if the piece would fall on the next tick.  n counts
+ *	the pieces from 1, x and y are where the piece's grid is and the rows of
+ *	the board follow in hex, top first, bit x for column x, full lines still
+ *	to go are sent full.  end ends each game, over is 1 if it ended by game
+ *	over.
+ *
+ *	The bot answers each piece line with one of:
+ *
+ *	place x rot
+ *	keys taps
+ *
+ *	place turns the piece to rot, moves its grid to x and hard drops it,
+ *	the same keys the built in bot uses.  keys taps each key in turn, l and
+ *	r for left and right, u to turn and h to hard drop, it may be empty to
+ *	leave the piece to fall.  The keys go through the same path as the keys
+ *	read.  In the window, the bot moves at most once a tick and its keys are
+ *	applied before the next tick's gravity, so it can play at 20G if it
+ *	answers within a tick.  Only POSIX is supported.
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE	200112L
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "SDL.h"
+#include "bloc.h"
+#include "board.h"
+#include "piece.h"
+#include "rng.h"
+#include "score.h"
+#include "game.h"
+#include "bot.h"
+#include "xbot.h"
+
+#define XB_SHELL	"/bin/sh"			// Shell the bot's command is run by
+#define XB_MAXIN	256					// Longest line from the bot
+#define XB_NUMLEN	21					// Longest number, with its space
+#define XB_NUMS		11					// Numbers before the rows of a piece line
+#define XB_ROWLEN	17					// Longest row of a piece line
+#define XB_TAPS		"lruh"				// Keys the bot can tap, see xb_taps
+
+// Longest line to the bot, a piece line's name, numbers, rows and newline
+#define XB_MAXOUT	(8 + XB_NUMS * XB_NUMLEN + BD_MAXH * XB_ROWLEN)
+
+#ifndef _WIN32
+// The bot, and the pipes to and from it
+static struct {
+	pid_t		pid;				// Bot's process, 0 if not started
+	int			to;					// Pipe to the bot's input
+	int			from;				// Pipe from the bot's output
+	bool		gone;				// The bot has stopped or gone wrong
+	char		out[XB_MAXOUT];		// Line being sent
+	char		in[XB_MAXIN];		// Bytes read, not yet a whole line
+	unsigned	len;
+} xb_bot;
+
+// Key for each letter of XB_TAPS
+static const g_key_t xb_taps[] = { G_LEFT, G_RIGHT, G_ROT, G_HARD };
+
+// Function prototypes
+static void xb_put(const char *s, int len);
+static bool xb_getline(char *s, int ms);
+static int xb_parse(const bloc_game_t *game, const char *s, g_event_t *evs);
+
+/*
+ *	Start the bot, running the command with the shell.  Exits if it can't
+ *	be started.
+ */
+void
+xb_start(const char *cmd) {
+	int to[2];		// Pipe to the bot, read end first
+	int from[2];	// Pipe from the bot
+
+	assert(cmd != NULL);
+	if (pipe(to) == -1 || pipe(from) == -1) {
+		b_error("Error making pipes for the bot: %s\n", strerror(errno));
+	}
+	fflush(stdout);
+	xb_bot.pid = fork();
+	if (xb_bot.pid == -1) {
+		b_error("Error starting the bot: %s\n", strerror(errno));
+	}
+	if (xb_bot.pid == 0) {
+		dup2(to[0], STDIN_FILENO);
+		dup2(from[1], STDOUT_FILENO);
+		close(to[0]);
+		close(to[1]);
+		close(from[0]);
+		close(from[1]);
+		execl(XB_SHELL, "sh", "-c", cmd, (char *) NULL);
+		_exit(EXIT_FAILURE);
+	}
+	close(to[0]);
+	close(from[1]);
+	xb_bot.to = to[1];
+	xb_bot.from = from[0];
+	fcntl(xb_bot.from, F_SETFL, fcntl(xb_bot.from, F_GETFL) | O_NONBLOCK);
+	signal(SIGPIPE, SIG_IGN);
+}
+
+/*
+ *	Tell the bot a game is starting, with the shapes the pieces are made
+ *	from.  Does nothing if there is no bot.
+ */
+void
+xb_game(const bloc_game_t *game) {
+	piece_t piece;	// Each shape in each rotation
+	int len;		// Length of the line
+
+	assert(game != NULL);
+	if (xb_bot.pid == 0) {
+		return;
+	}
+	len = snprintf(xb_bot.out, XB_MAXOUT, "game %d %d %d\n", game->board.w,
+			game->board.h, p_nshapes());
+	xb_put(xb_bot.out, len);
+	for (int i = 0; i < p_nshapes(); i++) {
+		len = snprintf(xb_bot.out, XB_MAXOUT, "shape %d", i);
+		piece.shape = i;
+		for (int r = 0; r < P_ROTS; r++) {
+			piece.rot = (p_rot_t) r;
+			len += snprintf(xb_bot.out + len, XB_MAXOUT - len, " %lx",
+					(unsigned long) p_mask(&piece));
+		}
+		len += snprintf(xb_bot.out + len, XB_MAXOUT - len, "\n");
+		xb_put(xb_bot.out, len);
+	}
+}
+
+/*
+ *	Send the bot the game as the piece comes on to the board.  The whole
+ *	line is written at once, so asking costs a write and the answer a read.
+ */
+void
+xb_send(const bloc_game_t *game) {
+	const piece_t *piece, *next;
+	int len;		// Length of the line
+
+	assert(game != NULL);
+	if (xb_bot.pid == 0) {
+		return;
+	}
+	piece = &game->piece;
+	next = &game->nextpiece;
+	len = snprintf(xb_bot.out, XB_MAXOUT,
+			"piece %u %llu %lu %u %d %d %d %d %d %d %d", game->pieces,
+			(unsigned long long) (game->time / G_TICKPART), s_get(game),
+			game->lines, G_LEV(game->grav.diff), piece->shape, piece->rot,
+			piece->x, piece->y, next->shape, next->rot);
+	for (int j = 0; j < game->board.h; j++) {
+		len += snprintf(xb_bot.out + len, XB_MAXOUT - len, " %llx",
+				(unsigned long long) BD_ROW(game, j));
+	}
+	len += snprintf(xb_bot.out + len, XB_MAXOUT - len, "\n");
+	assert(len < XB_MAXOUT);
+	xb_put(xb_bot.out, len);
+}
+
+/*
+ *	Get the bot's answer to the last piece sent and turn it into keys,
+ *	pressed and released at the game's time.  Returns the number of keys,
+ *	at most XB_MAXKEYS, XB_WAIT if it hasn't answered yet or XB_GONE if it
+ *	has stopped or given an answer that makes no sense, which is printed.
+ *	ms	- most time to wait for it, in ms, or XB_FOREVER
+ *	evs	- set to the keys
+ */
+int
+xb_reply(const bloc_game_t *game, int ms, g_event_t *evs) {
+	char s[XB_MAXIN];		// Line from the bot
+
+	assert(game != NULL && evs != NULL);
+	if (xb_bot.pid == 0 || xb_bot.gone) {
+		return XB_GONE;
+	}
+	if (!xb_getline(s, ms)) {
+		return xb_bot.gone ? XB_GONE : XB_WAIT;
+	}
+	return xb_parse(game, s, evs);
+}
+
+/*
+ *	Tell the bot the game has ended.  Does nothing if there is no bot.
+ *	over	- true if the game ended by game over rather than quitting
+ */
+void
+xb_end(const bloc_game_t *game, bool over) {
+	int len;		// Length of the line
+
+	assert(game != NULL);
+	if (xb_bot.pid == 0) {
+		return;
+	}
+	len = snprintf(xb_bot.out, XB_MAXOUT, "end %llu %d %lu\n",
+			(unsigned long long) (game->time / G_TICKPART), over,
+			s_get(game));
+	xb_put(xb_bot.out, len);
+}
+
+/*
+ *	Close the pipes, so the bot reads the end of its input, and wait for it
+ *	to stop.
+ */
+void
+xb_stop(void) {
+	if (xb_bot.pid == 0) {
+		return;
+	}
+	close(xb_bot.to);
+	close(xb_bot.from);
+	waitpid(xb_bot.pid, NULL, 0);
+	xb_bot.pid = 0;
+}
+
+/*
+ *	Write a line to the bot, unless it has gone.  A bot that has stopped
+ *	reading is marked as gone.
+ */
+void
+xb_put(const char *s, int len) {
+	ssize_t n;		// Bytes written
+
+	assert(s != NULL);
+	while (len > 0 && !xb_bot.gone) {
+		n = write(xb_bot.to, s, len);
+		if (n > 0) {
+			s += n;
+			len -= n;
+		} else if (n == -1 && errno != EINTR) {
+			fprintf(stderr, "Error writing to the bot: %s\n", strerror(errno));
+			xb_bot.gone = true;
+		}
+	}
+}
+
+/*
+ *	Read a line from the bot, without its new line.  Returns false if a
+ *	whole line hasn't arrived within the time given, or the bot has gone.
+ *	ms	- most time to wait, in ms, or XB_FOREVER
+ */
+bool
+xb_getline(char *s, int ms) {
+	struct pollfd pfd;		// Pipe to wait on
+	char *nl;				// End of the line
+	ssize_t n;				// Bytes read
+	unsigned len;			// Length of the line
+
+	assert(s != NULL);
+	pfd.fd = xb_bot.from;
+	pfd.events = POLLIN;
+	while ((nl = memchr(xb_bot.in, '\n', xb_bot.len)) == NULL) {
+		if (xb_bot.len == XB_MAXIN) {
+			fprintf(stderr, "Error: line from the bot is too long\n");
+			xb_bot.gone = true;
+			return false;
+		}
+		n = read(xb_bot.from, xb_bot.in + xb_bot.len, XB_MAXIN - xb_bot.len);
+		if (n > 0) {
+			xb_bot.len += n;
+		} else if (n == 0) {
+			fprintf(stderr, "Error: the bot has stopped\n");
+			xb_bot.gone = true;
+			return false;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			if (ms == 0 || poll(&pfd, 1, ms) <= 0) {
+				return false;
+			}
+		} else if (errno != EINTR) {
+			fprintf(stderr, "Error reading from the bot: %s\n",
+					strerror(errno));
+			xb_bot.gone = true;
+			return false;
+		}
+	}
+	len = nl - xb_bot.in;
+	memcpy(s, xb_bot.in, len);
+	s[len] = '\0';
+	xb_bot.len -= len + 1;
+	memmove(xb_bot.in, nl + 1, xb_bot.len);
+	return true;
+}
+
+/*
+ *	Turn an answer from the bot into keys, pressed and released at the
+ *	game's time.  Returns the number of keys or, if the answer makes no
+ *	sense, XB_GONE.
+ *	evs	- set to the keys
+ */
+int
+xb_parse(const bloc_game_t *game, const char *s, g_event_t *evs) {
+	bt_move_t move;			// Move to make with place
+	const char *key;		// Key tapped
+	int x, rot;				// Where to place the piece
+	int nkeys = 0;			// Number of keys
+
+	assert(game != NULL && s != NULL && evs != NULL);
+	if (sscanf(s, "place %d %d", &x, &rot) == 2) {
+		if (rot < 0 || rot >= P_ROTS || abs(x - game->piece.x) > BD_MAXW) {
+			fprintf(stderr, "Error: the bot can't place at %s\n", s);
+			xb_bot.gone = true;
+			return XB_GONE;
+		}
+		move.rots = (rot - (int) game->piece.rot + P_ROTS) % P_ROTS;
+		move.dx = x - game->piece.x;
+		return bt_keys(&move, game->time, evs);
+	}
+	if (strncmp(s, "keys", 4) != 0 || (s[4] != ' ' && s[4] != '\0')) {
+		fprintf(stderr, "Error: the bot said %s\n", s);
+		xb_bot.gone = true;
+		return XB_GONE;
+	}
+	for (s += 4; *s != '\0'; s++) {
+		if (*s == ' ' || *s == '\r') {
+			continue;
+		}
+		key = strchr(XB_TAPS, *s);
+		if (key == NULL || nkeys == XB_MAXKEYS) {
+			fprintf(stderr, "Error: the bot can't tap %c\n", *s);
+			xb_bot.gone = true;
+			return XB_GONE;
+		}
+		for (int i = 0; i < 2; i++) {
+			evs[nkeys].time = game->time;
+			evs[nkeys].key = xb_taps[key - XB_TAPS];
+			evs[nkeys].down = (i == 0);
+			nkeys++;
+		}
+	}
+	return nkeys;
+}
+
+#else // _WIN32
+
+/*
+ *	External bots aren't supported.
+ */
+void
+xb_start(const char *cmd) {
+	(void) cmd;
+	b_error("Error: external bots aren't supported on Windows\n");
+}
+
+/*
+ *	There is never a bot to tell.
+ */
+void
+xb_game(const bloc_game_t *game) {
+	(void) game;
+}
+
+/*
+ *	There is never a bot to send to.
+ */
+void
+xb_send(const bloc_game_t *game) {
+	(void) game;
+}
+
+/*
+ *	There is never a bot to answer.
+ */
+int
+xb_reply(const bloc_game_t *game, int ms, g_event_t *evs) {
+	(void) game;
+	(void) ms;
+	(void) evs;
+	return XB_GONE;
+}
+
+/*
+ *	There is never a bot to tell.
+ */
+void
+xb_end(const bloc_game_t *game, bool over) {
+	(void) game;
+	(void) over;
+}
+
+/*
+ *	There is never a bot to stop.
+ */
+void
+xb_stop(void) {
+	// VOID
+}
+
+#endif // _WIN32
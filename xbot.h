@@ -0,0 +1,26 @@
+/*
+ *	See LICENSE.txt file for copyright and license details.
+ *
+ *	Requires: <stdbool.h>, <SDL/SDL.h>, "bloc.h", "game.h"
+ *
+ *	Definitions for an external bot, run as another program.
+ */
+
+#ifndef XBOT_H
+#define XBOT_H
+
+#define XB_MAXTAPS	128					// Most keys in a reply
+#define XB_MAXKEYS	(2 * XB_MAXTAPS)	// Most keys pressed and released
+#define XB_FOREVER	(-1)				// Wait for a reply however long
+#define XB_WAIT		(-1)				// No reply yet
+#define XB_GONE		(-2)				// The bot has stopped or gone wrong
+
+// Function prototypes
+extern void xb_start(const char *cmd);
+extern void xb_game(const bloc_game_t *game);
+extern void xb_send(const bloc_game_t *game);
+extern int xb_reply(const bloc_game_t *game, int ms, g_event_t *evs);
+extern void xb_end(const bloc_game_t *game, bool over);
+extern void xb_stop(void);
+
+#endif // XBOT_H